@@ -0,0 +1,63 @@
+# Runs every day on its shipped input in an instrumented build, so that the
+# profile covers the code each day actually exercises. Invoked by the
+# `pgo-train` target with SOURCE_DIR, BINARY_DIR, PROFILE_DIR, COMPILER_ID
+# and COMPILER set.
+
+function(train name)
+    cmake_parse_arguments(PARSE_ARGV 1 TRAIN "" "STDIN" "ARGS")
+
+    set(input)
+    if(DEFINED TRAIN_STDIN)
+        set(stdinFile "${BINARY_DIR}/pgo-stdin.txt")
+        file(WRITE "${stdinFile}" "${TRAIN_STDIN}\n")
+        set(input INPUT_FILE "${stdinFile}")
+    endif()
+
+    message(STATUS "Training ${name} ${TRAIN_ARGS}")
+    execute_process(
+        COMMAND "${BINARY_DIR}/${name}" ${TRAIN_ARGS}
+        ${input}
+        WORKING_DIRECTORY "${SOURCE_DIR}"
+        OUTPUT_QUIET
+        RESULT_VARIABLE result
+    )
+
+    if(NOT result EQUAL 0)
+        message(FATAL_ERROR "${name} ${TRAIN_ARGS} failed: ${result}")
+    endif()
+endfunction()
+
+file(REMOVE_RECURSE "${PROFILE_DIR}")
+
+train(day-1 ARGS day-1/input.txt)
+train(day-2 ARGS day-2/input/input.txt)
+train(day-3 ARGS day-3/input/input.txt)
+train(day-4)
+train(day-5 ARGS day-5/input/input.txt STDIN 1)
+train(day-5 ARGS day-5/input/input.txt STDIN 5)
+train(day-6 ARGS day-6/input/input.txt)
+train(day-7 ARGS day-7/input/input.txt)
+train(day-7 ARGS day-7/input/input.txt pipelined)
+train(day-8 ARGS 25 6 day-8/input/input.txt)
+train(day-9 ARGS day-9/input/input.txt STDIN 1)
+train(day-9 ARGS day-9/input/input.txt 2 5)
+train(day-9 ARGS day-9/input/input.txt 2 5 jit)
+train(day-9-aot ARGS day-9/input/input.txt 2 5)
+train(benchmark ARGS . 3 0)
+
+# NOTE: Clang writes raw profiles that have to be merged before use; GCC
+# reads its .gcda files directly.
+if(COMPILER_ID MATCHES "Clang")
+    get_filename_component(compilerDir "${COMPILER}" DIRECTORY)
+    find_program(PROFDATA NAMES llvm-profdata HINTS "${compilerDir}" REQUIRED)
+
+    file(GLOB rawProfiles "${PROFILE_DIR}/*.profraw")
+    execute_process(
+        COMMAND "${PROFDATA}" merge -output=${PROFILE_DIR}/default.profdata ${rawProfiles}
+        RESULT_VARIABLE result
+    )
+
+    if(NOT result EQUAL 0)
+        message(FATAL_ERROR "llvm-profdata merge failed: ${result}")
+    endif()
+endif()
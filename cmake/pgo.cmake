@@ -0,0 +1,27 @@
+# Builds every target with profile-guided and link-time optimization:
+#
+#     cmake -DBINARY_DIR=build-pgo -P cmake/pgo.cmake
+#
+# The build directory is first configured with an instrumented build, which
+# is trained on the shipped inputs, and then reconfigured and rebuilt from
+# scratch against the recorded profile. The same directory is used for both
+# stages, since GCC matches profiles to object files by path.
+
+get_filename_component(SOURCE_DIR "${CMAKE_CURRENT_LIST_DIR}/.." ABSOLUTE)
+
+if(NOT DEFINED BINARY_DIR)
+    set(BINARY_DIR "${SOURCE_DIR}/build-pgo")
+endif()
+
+function(run)
+    execute_process(COMMAND ${ARGN} RESULT_VARIABLE result)
+    if(NOT result EQUAL 0)
+        message(FATAL_ERROR "Failed: ${ARGN}")
+    endif()
+endfunction()
+
+run(${CMAKE_COMMAND} -S "${SOURCE_DIR}" -B "${BINARY_DIR}" -DCMAKE_BUILD_TYPE=Release -DAOC_PGO=generate -DAOC_LTO=OFF)
+run(${CMAKE_COMMAND} --build "${BINARY_DIR}" --target pgo-train)
+
+run(${CMAKE_COMMAND} -S "${SOURCE_DIR}" -B "${BINARY_DIR}" -DAOC_PGO=use -DAOC_LTO=ON)
+run(${CMAKE_COMMAND} --build "${BINARY_DIR}" --clean-first)
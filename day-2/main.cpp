@@ -1,62 +1,159 @@
-#include <fstream>
+#include <algorithm>
+#include <atomic>
 #include <iostream>
-#include <string>
 #include <cstdint>
+#include <limits>
+#include <string>
+#include <thread>
 #include <vector>
 
-void read_input(const char * filename, std::vector<int32_t> * values)
-{
-    std::ifstream fs;
-    fs.open(filename, std::ifstream::in);
-
-    std::string s;
-    for (std::string s; std::getline(fs, s, ','); )
-    {
-        auto i = std::stoul(s);
-
-        values->push_back(i);
-    }
-}
+#include "../intcode/batch.h"
+#include "../intcode/computer.h"
+#include "../intcode/program.h"
+#include "../intcode/symbolic.h"
 
-void part1(std::vector<int32_t> * values)
+void part1(std::vector<int64_t> * values)
 {
     (*values)[1] = 12;
     (*values)[2] = 2;
 }
 
-int32_t process(std::vector<int32_t> values, int start = 0)
+// Candidates are run kBatchLanes at a time, one per lane of a batch machine.
+constexpr size_t kBatchLanes = 16;
+
+using Batch = BatchComputer<kBatchLanes>;
+
+// Nouns and verbs are searched in the half-open ranges [min, max).
+struct SearchSpace
+{
+    int64_t nounMin;
+    int64_t nounMax;
+    int64_t verbMin;
+    int64_t verbMax;
+    int64_t target;
+};
+
+struct SearchResult
 {
-    for (int i = start; ; i += 4)
+    bool found;
+    int64_t noun;
+    int64_t verb;
+};
+
+// Splits the candidates into rows of one noun each and hands them out to
+// the workers through a shared counter. Once a match is found, workers skip
+// every row after it, but rows before it are still finished so the result is
+// the same first match a serial search would report. Within a row, each
+// worker runs the verbs in lockstep batches.
+SearchResult search(const std::vector<int64_t> & values, const SearchSpace & space, unsigned threads)
+{
+    constexpr int64_t kNotFound = std::numeric_limits<int64_t>::max();
+
+    auto verbs = space.verbMax - space.verbMin;
+    auto rows = space.nounMax - space.nounMin;
+
+    std::atomic<int64_t> nextRow(0);
+    std::atomic<int64_t> best(kNotFound);
+
+    auto worker = [&]()
     {
-        auto op = values[i];
-        switch (op)
+        Batch batch(values);
+
+        for (auto row = nextRow++; row < rows; row = nextRow++)
         {
-            case 1:
+            if (row * verbs >= best.load(std::memory_order_relaxed))
             {
-                auto op1 = values[i + 1];
-                auto op2 = values[i + 2];
-                auto result = values[i + 3];
+                return;
+            }
 
-                values[result] = values[op1] + values[op2];
-            } break;
-            case 2:
+            for (int64_t first = 0; first < verbs; first += kBatchLanes)
             {
-                auto op1 = values[i + 1];
-                auto op2 = values[i + 2];
-                auto result = values[i + 3];
+                auto count = std::min<int64_t>(kBatchLanes, verbs - first);
 
-                values[result] = values[op1] * values[op2];
-            } break;
-            case 99:
-            {
-                return values[0];
-            } break;
-            default:
-            {
-                return 0;
-            } break;
+                // NOTE: Spare lanes repeat the last verb rather than sitting
+                // idle at a different address.
+                batch.load(values);
+                for (size_t lane = 0; lane < kBatchLanes; ++lane)
+                {
+                    batch.write(lane, 1, space.nounMin + row);
+                    batch.write(lane, 2, space.verbMin + first + std::min<int64_t>(lane, count - 1));
+                }
+
+                batch.process();
+
+                int64_t match = -1;
+                for (int64_t lane = 0; lane < count; ++lane)
+                {
+                    if (batch.state(lane) == Computer::Halted && batch.read(lane, 0) == space.target)
+                    {
+                        match = lane;
+                        break;
+                    }
+                }
+
+                if (match >= 0)
+                {
+                    auto index = row * verbs + first + match;
+                    auto current = best.load();
+                    while (index < current && !best.compare_exchange_weak(current, index)) {}
+
+                    break;
+                }
+            }
         }
+    };
+
+    std::vector<std::thread> workers;
+    for (unsigned i = 1; i < threads; ++i)
+    {
+        workers.emplace_back(worker);
+    }
+
+    worker();
+
+    for (auto & t : workers)
+    {
+        t.join();
+    }
+
+    auto index = best.load();
+    if (index == kNotFound)
+    {
+        return SearchResult{ false, 0, 0 };
     }
+
+    return SearchResult{ true, space.nounMin + index / verbs, space.verbMin + index % verbs };
+}
+
+// Runs the program once with the noun and verb left symbolic and solves the
+// resulting closed form for the target. Returns false when the program does
+// something that needs concrete values, so the caller has to search instead.
+bool solve_symbolic(const std::vector<int64_t> & values, const SearchSpace & space, SearchResult * result)
+{
+    SymbolicComputer c(values);
+    c.make_symbolic(1, "noun");
+    c.make_symbolic(2, "verb");
+
+    if (c.process() != SymbolicComputer::Halted)
+    {
+        return false;
+    }
+
+    auto output = c.read(0);
+    if (output.is_unknown())
+    {
+        return false;
+    }
+
+    std::vector<int64_t> solution;
+    result->found = solve(output, space.target, { { space.nounMin, space.nounMax }, { space.verbMin, space.verbMax } }, &solution);
+    if (result->found)
+    {
+        result->noun = solution[0];
+        result->verb = solution[1];
+    }
+
+    return true;
 }
 
 int main(int argc, char * argv[])
@@ -64,32 +161,50 @@ int main(int argc, char * argv[])
     if (argc < 2)
     {
         std::cout << "Expects input file argument" << std::endl;
+        std::cout << "Usage: day-2 <input> [target] [noun min] [noun max] [verb min] [verb max] [threads]" << std::endl;
 
         return 1;
     }
 
     auto filename = argv[1];
 
-    std::vector<int32_t> values;
-    read_input(filename, &values);
+    SearchSpace space{ 0, 100, 0, 100, 19690720 };
+    if (argc > 2) { space.target = std::stoll(argv[2]); }
+    if (argc > 3) { space.nounMin = std::stoll(argv[3]); }
+    if (argc > 4) { space.nounMax = std::stoll(argv[4]); }
+    if (argc > 5) { space.verbMin = std::stoll(argv[5]); }
+    if (argc > 6) { space.verbMax = std::stoll(argv[6]); }
+
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    if (argc > 7) { threads = std::max(1, std::stoi(argv[7])); }
+
+    std::vector<int64_t> values;
+    read_program(filename, &values);
 
-    for (auto noun = 0; noun < 99; ++noun)
     {
-        for (auto verb = 0; verb < 99; ++verb)
-        {
-            auto copy = values;
-            copy[1] = noun;
-            copy[2] = verb;
+        auto patched = values;
+        part1(&patched);
 
-            auto result = process(copy);
+        BasicComputer<BasicFeatures, NoIO> c(patched);
+        c.process();
 
-            if (result == 19690720)
-            {
-                std::cout << "noun " << noun << std::endl;
-                std::cout << "verb " << verb << std::endl;
-                std::cout << (100 * noun) + verb << std::endl;
-            }
-        }
+        std::cout << c.read(0) << std::endl;
+    }
+
+    SearchResult result{ false, 0, 0 };
+    if (!solve_symbolic(values, space, &result))
+    {
+        result = search(values, space, threads);
+    }
+    if (result.found)
+    {
+        std::cout << "noun " << result.noun << std::endl;
+        std::cout << "verb " << result.verb << std::endl;
+        std::cout << (100 * result.noun) + result.verb << std::endl;
+    }
+    else
+    {
+        std::cout << "No noun/verb produces " << space.target << std::endl;
     }
 
     return 0;
@@ -3,7 +3,7 @@
 #include <string>
 #include <cstdint>
 #include <vector>
-#include <strstream>
+#include <sstream>
 #include <cmath>
 #include <algorithm>
 
@@ -57,7 +57,7 @@ void read_input(const char * filename, std::vector<std::string> * v)
 
 std::vector<Line> make_line_segments(std::string & s)
 {
-    std::strstream ss;
+    std::stringstream ss;
     ss << s;
 
     std::vector<Line> lines;
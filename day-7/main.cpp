@@ -1,225 +1,368 @@
-#include <fstream>
+#include <algorithm>
 #include <iostream>
+#include <limits>
+#include <map>
+#include <memory>
 #include <string>
 #include <cstdint>
+#include <thread>
+#include <utility>
 #include <vector>
 
-#include "computer1.h"
-#include "computer2.h"
+#include "../intcode/computer.h"
+#include "../intcode/coroutine.h"
+#include "../intcode/pipeline.h"
+#include "../intcode/pool.h"
+#include "../intcode/program.h"
+#include "../intcode/work_stealing.h"
 
-void read_input(const char * filename, std::vector<int32_t> * values)
-{
-    std::ifstream fs;
-    fs.open(filename, std::ifstream::in);
+#include "permutation.h"
+
+// The amplifier programs predate relative mode, so the machines are built
+// without it.
+using Amplifier = BasicComputer<BasicFeatures>;
 
-    std::string s;
-    for (std::string s; std::getline(fs, s, ','); )
+std::string to_string(const std::vector<int> & a)
+{
+    std::string s = "[";
+    for (size_t i = 0; i < a.size(); ++i)
     {
-        auto i = std::stoul(s);
+        s += ((i > 0) ? "," : "") + std::to_string(a[i]);
+    }
+
+    return s + "]";
+}
 
-        values->push_back(i);
+void reset_amplifiers(std::vector<Amplifier *> & amplifiers, const BasicComputerPool<Amplifier> & pool)
+{
+    for (auto amplifier : amplifiers)
+    {
+        pool.reset(*amplifier);
     }
 }
 
-std::string to_string(const std::vector<int> & a)
+// A contiguous range [first, last) of permutation ranks.
+struct PhaseTask
 {
-    return "["
-        + std::to_string(a[0]) + ","
-        + std::to_string(a[1]) + ","
-        + std::to_string(a[2]) + ","
-        + std::to_string(a[3]) + ","
-        + std::to_string(a[4]) + "]";
+    uint64_t first;
+    uint64_t last;
+};
+
+struct PhaseResult
+{
+    int64_t signal;
+    std::vector<int> order;
+};
+
+// NOTE: Ties go to the lexicographically smallest order, so the answer does
+// not depend on how the work happened to be split.
+bool improves(const PhaseResult & best, int64_t signal, const std::vector<int> & order)
+{
+    return signal > best.signal || (signal == best.signal && order < best.order);
 }
 
-class HeapsAlgorithm
+// Ranges longer than this are split in half, so idle workers have something
+// to steal.
+constexpr uint64_t kLeafOrders = 8;
+
+// Tries every order of the phases. On more than one thread the ranks are
+// split across a work-stealing pool; each worker owns its own set of
+// amplifiers and its own best result, and the per-worker results are only
+// combined once the pool is done, so the workers never share anything but the
+// task deques. A single thread just steps one order through every
+// permutation in place. Between orders the amplifiers are reset rather than
+// rebuilt, which only restores the memory the last order wrote.
+template <typename Evaluate>
+PhaseResult search_phases(const std::vector<int64_t> & program, const std::vector<int> & phases,
+                          unsigned threads, Evaluate evaluate)
 {
-public:
-    HeapsAlgorithm(int n_, std::vector<int> a_) : n(n_), a(a_), i(0), complete(false)
+    WorkStealingPool<PhaseTask> pool(threads);
+    BasicComputerPool<Amplifier> computers(program);
+
+    std::vector<std::vector<Amplifier *>> amplifiers(pool.workers());
+    std::vector<PhaseResult> best(pool.workers(), PhaseResult{ std::numeric_limits<int64_t>::min(), {} });
+
+    auto visit = [&](size_t worker, const std::vector<int> & order)
     {
-        c.reserve(n);
+        auto & machines = amplifiers[worker];
+        if (machines.empty())
+        {
+            for (size_t i = 0; i < phases.size(); ++i)
+            {
+                machines.push_back(&computers.acquire());
+            }
+        }
+        else
+        {
+            reset_amplifiers(machines, computers);
+        }
 
-        for (int i = 0; i < n; ++i)
+        auto signal = evaluate(machines, order);
+        if (improves(best[worker], signal, order))
         {
-            c[i] = 0;
+            best[worker].signal = signal;
+            best[worker].order = order;
         }
-    }
-    ~HeapsAlgorithm() = default;
+    };
 
-    bool finished()
+    if (pool.workers() == 1)
     {
-        return complete;
+        auto order = phases;
+        Permutations<int> permutations(order);
+        do
+        {
+            visit(0, order);
+        } while (permutations.next());
+
+        return best[0];
     }
 
-    bool next(std::vector<int> * output)
+    pool.run({ PhaseTask{ 0, factorial(phases.size()) } }, [&](size_t worker, PhaseTask & task)
     {
-        static bool first = true;
-
-        if (first)
+        if (task.last - task.first > kLeafOrders)
         {
-            first = false;
-            *output = a;
+            auto middle = task.first + (task.last - task.first) / 2;
+            pool.spawn(worker, PhaseTask{ middle, task.last });
+            pool.spawn(worker, PhaseTask{ task.first, middle });
 
-            return true;
+            return;
         }
 
-        while (i < n)
+        std::vector<int> order(phases.size());
+        for (auto rank = task.first; rank < task.last; ++rank)
         {
-            if (c[i] < i)
-            {
-                if (i % 2 == 0)
-                {
-                    std::swap(a[0], a[i]);
-                }
-                else
-                {
-                    std::swap(a[c[i]], a[i]);
-                }
+            unrank_permutation<int>(rank, phases, order);
+            visit(worker, order);
+        }
+    });
 
-                *output = a;
+    auto winner = best[0];
+    for (auto & result : best)
+    {
+        if (improves(winner, result.signal, result.order))
+        {
+            winner = result;
+        }
+    }
 
-                c[i] += 1;
-                i = 0;
+    return winner;
+}
 
-                return true;
-            }
-            else
-            {
-                c[i] = 0;
-                i += 1;
-            }
-        }
+// Prefixes with more free phases than this are split into one task per
+// choice of the next phase.
+constexpr size_t kLeafPhases = 3;
 
-        complete = true;
+// Amplifiers in series are a pure function of their phase and input signal,
+// so part 1 walks the tree of phase prefixes instead of running every order
+// from scratch. A task carries the signal leaving its prefix, and each worker
+// remembers the output for every (phase, signal) pair it has run, so shared
+// prefixes and repeated stages run once per worker.
+struct ChainTask
+{
+    std::vector<int> order;
+    size_t depth;
+    int64_t signal;
+};
+
+struct ChainWorker
+{
+    std::map<std::pair<int, int64_t>, int64_t> outputs;
+    PhaseResult best;
+};
 
-        return false;
+int64_t run_stage(BasicComputerPool<Amplifier> & pool, ChainWorker & worker, int phase, int64_t signal)
+{
+    auto inserted = worker.outputs.try_emplace({ phase, signal }, 0);
+    auto & output = inserted.first->second;
+    if (inserted.second)
+    {
+        auto & amp = pool.acquire();
+        amp.push_input(phase);
+        amp.push_input(signal);
+        amp.process();
+        amp.pop_output(&output);
+        pool.release(amp);
     }
 
-private:
-    int n;
-    int i;
-    bool complete;
-    std::vector<int> a;
-    std::vector<int> c;
-};
+    return output;
+}
 
-void part1(const std::vector<int> & program)
+void walk_chain(BasicComputerPool<Amplifier> & pool, ChainWorker & worker, std::vector<int> & order, size_t depth, int64_t signal)
 {
-    std::vector<int32_t> phases = {0, 1, 2, 3, 4};
+    if (depth == order.size())
+    {
+        if (improves(worker.best, signal, order))
+        {
+            worker.best.signal = signal;
+            worker.best.order = order;
+        }
 
-    auto permutator = HeapsAlgorithm(5, phases);
+        return;
+    }
 
-    std::vector<int> order;
-    int max = std::numeric_limits<int>::min();
-    while (permutator.next(&order))
+    for (auto i = depth; i < order.size(); ++i)
     {
-        int32_t phase = 0;
-        int32_t input = 0;
-        for (int i = 0; i < 5; ++i)
+        std::swap(order[depth], order[i]);
+        walk_chain(pool, worker, order, depth + 1, run_stage(pool, worker, order[depth], signal));
+        std::swap(order[depth], order[i]);
+    }
+}
+
+PhaseResult search_chain(const std::vector<int64_t> & program, const std::vector<int> & phases, unsigned threads)
+{
+    WorkStealingPool<ChainTask> pool(threads);
+    BasicComputerPool<Amplifier> computers(program);
+
+    std::vector<ChainWorker> workers(pool.workers(), ChainWorker{ {}, PhaseResult{ std::numeric_limits<int64_t>::min(), {} } });
+
+    pool.run({ ChainTask{ phases, 0, 0 } }, [&](size_t index, ChainTask & task)
+    {
+        auto & worker = workers[index];
+        if (task.order.size() - task.depth > kLeafPhases)
         {
-            phase = order[i];
+            for (auto i = task.depth; i < task.order.size(); ++i)
+            {
+                auto child = task;
+                std::swap(child.order[task.depth], child.order[i]);
+                child.signal = run_stage(computers, worker, child.order[task.depth], task.signal);
+                ++child.depth;
 
-            Computer amp(program, {phase, input});
-            amp.process();
+                pool.spawn(index, std::move(child));
+            }
 
-            input = amp.get_output()[0];
+            return;
         }
 
-        if (input > max)
+        walk_chain(computers, worker, task.order, task.depth, task.signal);
+    });
+
+    auto winner = workers[0].best;
+    for (auto & worker : workers)
+    {
+        if (improves(winner, worker.best.signal, worker.best.order))
         {
-            max = input;
+            winner = worker.best;
         }
     }
 
-    std::cout << max << std::endl;
+    return winner;
 }
 
-void reset_amplifiers(std::vector<Computer2> & amplifiers, const std::vector<int> & program)
+// Runs the amplifiers as coroutines on the calling thread, so a signal is
+// handed straight to the waiting machine and its output comes straight back.
+int64_t run_feedback_loop(std::vector<Amplifier *> & amplifiers, const std::vector<int> & order)
 {
-    amplifiers[0] = Computer2(program);
-    amplifiers[1] = Computer2(program);
-    amplifiers[2] = Computer2(program);
-    amplifiers[3] = Computer2(program);
-    amplifiers[4] = Computer2(program);
+    std::vector<Machine> machines;
+    machines.reserve(amplifiers.size());
+    for (size_t i = 0; i < amplifiers.size(); ++i)
+    {
+        amplifiers[i]->push_input(order[i]);
+        machines.push_back(Machine::run(*amplifiers[i]));
+    }
+
+    int64_t input = 0;
+    for (size_t i = 0; ; i = (i + 1) % machines.size())
+    {
+        if (machines[i].resume(input) != Machine::HasOutput)
+        {
+            break;
+        }
+
+        input = machines[i].value();
+    }
+
+    return input;
 }
 
-void part2(const std::vector<int> & program)
+// Runs every amplifier on its own thread, so all stages execute at once. The
+// search hands a worker the same amplifiers for every order, so the pipeline
+// and its threads are only set up again if those change.
+int64_t run_pipelined(std::unique_ptr<BasicPipeline<Amplifier>> & pipeline, std::vector<Amplifier *> & amplifiers,
+                      const std::vector<int> & order)
 {
-    std::vector<int32_t> phases = {5, 6, 7, 8, 9};
-
-    auto permutator = HeapsAlgorithm(5, phases);
-    auto amplifiers = std::vector<Computer2>
+    if (!pipeline || !pipeline->runs(amplifiers))
     {
-        Computer2(program),
-        Computer2(program),
-        Computer2(program),
-        Computer2(program),
-        Computer2(program),
-    };
+        pipeline.reset();
+        pipeline = std::make_unique<BasicPipeline<Amplifier>>(amplifiers);
+    }
 
-    auto isHalted = [&amplifiers]()
+    for (size_t i = 0; i < amplifiers.size(); ++i)
     {
-        return amplifiers[0].halted()
-            && amplifiers[1].halted()
-            && amplifiers[2].halted()
-            && amplifiers[3].halted()
-            && amplifiers[4].halted();
-    };
+        amplifiers[i]->push_input(order[i]);
+    }
 
-    std::vector<int> order;
-    std::vector<int> maxOrder;
-    int max = std::numeric_limits<int>::min();
-    while (permutator.next(&order))
+    amplifiers[0]->push_input(0);
+
+    pipeline->run();
+
+    // The last amplifier's final signal is left waiting for the first one.
+    int64_t signal = 0;
+    for (int64_t value; amplifiers[0]->input().pop(&value); )
     {
-        reset_amplifiers(amplifiers, program);
+        signal = value;
+    }
 
-        int32_t phase = 0;
-        int32_t input = 0;
-        for (int i = 0; ; ++i)
-        {
-            phase = order[i % 5];
-            Computer2 & amp = amplifiers[i % 5];
-            amp.setInput(amp.started() ? std::vector<int>{input} : std::vector<int>{phase, input});
-            amp.process();
+    return signal;
+}
 
-            auto out = amp.get_output();
-            if (amp.halted() && out.size() == 0)
-            {
-                if (out.size() > 0)
-                {
-                    input = out[0];
-                }
-
-                if (input > max)
-                {
-                    max = input;
-                    maxOrder = order;
-                }
-
-                break;
-            }
+void part1(const std::vector<int64_t> & program, unsigned threads)
+{
+    auto result = search_chain(program, { 0, 1, 2, 3, 4 }, threads);
 
-            input = out[0];
-        }
+    std::cout << result.signal << std::endl;
+}
+
+void part2(const std::vector<int64_t> & program, unsigned threads, bool pipelined)
+{
+    // NOTE: The pipelined mode already runs one thread per amplifier, so it
+    // searches on a single worker rather than oversubscribing the machine.
+    PhaseResult result;
+    if (pipelined)
+    {
+        std::unique_ptr<BasicPipeline<Amplifier>> pipeline;
+        result = search_phases(program, { 5, 6, 7, 8, 9 }, 1, [&pipeline](std::vector<Amplifier *> & amplifiers, const std::vector<int> & order)
+        {
+            return run_pipelined(pipeline, amplifiers, order);
+        });
+    }
+    else
+    {
+        result = search_phases(program, { 5, 6, 7, 8, 9 }, threads, run_feedback_loop);
     }
 
-    std::cout << to_string(maxOrder) << " " << max << std::endl;
+    std::cout << to_string(result.order) << " " << result.signal << std::endl;
 }
 
 int main(int argc, char * argv[])
 {
     if (argc < 2)
     {
-        std::cout << "Expects input file argument" << std::endl;
+        std::cout << "Usage: day-7 <input> [threads] [pipelined]" << std::endl;
 
         return 1;
     }
 
     auto filename = argv[1];
 
-    std::vector<int32_t> program;
-    read_input(filename, &program);
+    std::vector<int64_t> program;
+    read_program(filename, &program);
+
+    unsigned threads = std::max(std::thread::hardware_concurrency(), 1u);
+    bool pipelined = false;
+    for (int i = 2; i < argc; ++i)
+    {
+        if (std::string(argv[i]) == "pipelined")
+        {
+            pipelined = true;
+        }
+        else
+        {
+            threads = std::max(std::stoi(argv[i]), 1);
+        }
+    }
 
-    part2(program);
+    part1(program, threads);
+    part2(program, threads, pipelined);
 
     return 0;
 }
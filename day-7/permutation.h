@@ -0,0 +1,97 @@
+#ifndef DAY7_PERMUTATION_H
+#define DAY7_PERMUTATION_H
+
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <utility>
+
+// 20! is the largest factorial that fits in 64 bits.
+constexpr size_t kMaxPermutationSize = 20;
+
+constexpr uint64_t factorial(size_t n)
+{
+    uint64_t result = 1;
+    for (size_t i = 2; i <= n; ++i)
+    {
+        result *= i;
+    }
+
+    return result;
+}
+
+// Steps a span through all of its permutations in place, one swap per step
+// (Heap's algorithm). The span itself is the output, so nothing is copied or
+// allocated, and every instance has its own state:
+//
+//     Permutations<int> permutations(order);
+//     do { visit(order); } while (permutations.next());
+template <typename T>
+class Permutations
+{
+public:
+    explicit Permutations(std::span<T> values)
+        : m_values(values)
+        , m_counters{}
+        , m_index(1)
+    {
+        assert(values.size() <= kMaxPermutationSize);
+    }
+
+    ~Permutations() = default;
+
+    // Moves to the next permutation. Returns false once every permutation
+    // has been visited.
+    bool next()
+    {
+        while (m_index < m_values.size())
+        {
+            if (m_counters[m_index] < m_index)
+            {
+                auto other = (m_index % 2 == 0) ? 0 : m_counters[m_index];
+                std::swap(m_values[other], m_values[m_index]);
+
+                ++m_counters[m_index];
+                m_index = 1;
+
+                return true;
+            }
+
+            m_counters[m_index] = 0;
+            ++m_index;
+        }
+
+        return false;
+    }
+
+private:
+    std::span<T> m_values;
+    std::array<uint8_t, kMaxPermutationSize> m_counters;
+    size_t m_index;
+};
+
+// Writes permutation number `rank` of `elements` to `out` in O(n), using
+// Myrvold and Ruskey's ordering rather than lexicographic order. Every rank in
+// [0, n!) gives a different permutation, so workers can split the whole space
+// into ranges of ranks without sharing any state.
+template <typename T>
+void unrank_permutation(uint64_t rank, std::span<const T> elements, std::span<T> out)
+{
+    assert(elements.size() == out.size() && out.size() <= kMaxPermutationSize);
+    assert(rank < factorial(out.size()));
+
+    for (size_t i = 0; i < out.size(); ++i)
+    {
+        out[i] = elements[i];
+    }
+
+    for (auto n = out.size(); n > 1; --n)
+    {
+        std::swap(out[n - 1], out[rank % n]);
+        rank /= n;
+    }
+}
+
+#endif
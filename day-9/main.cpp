@@ -1,226 +1,88 @@
-#include <fstream>
+#include <chrono>
 #include <iostream>
-#include <string>
 #include <cstdint>
+#include <string>
 #include <vector>
 
-void read_input(const char * filename, std::vector<int64_t> * values)
+#include "../intcode/computer.h"
+#include "../intcode/console.h"
+#include "../intcode/jit.h"
+#include "../intcode/program.h"
+
+// NOTE: Build with -DINTCODE_AOT_PROGRAM=<symbol> and the output of
+// `intcode2cpp <program> <symbol>` to run a translated program instead of
+// interpreting it.
+#if defined(INTCODE_AOT_PROGRAM)
+    #include "../intcode/aot.h"
+
+    extern const CompiledProgram INTCODE_AOT_PROGRAM;
+#endif
+
+// NOTE: Build with -DINTCODE_PROFILE to print an opcode and hotspot profile
+// of the interactive run on stderr once the program stops.
+#if defined(INTCODE_PROFILE)
+    #include "../intcode/profiler.h"
+#endif
+
+// Runs the machine to completion, discarding its output.
+template <typename Vm, typename Process>
+Computer::State run_discarding_output(Vm & c, Process process)
 {
-    std::ifstream fs;
-    fs.open(filename, std::ifstream::in);
-
-    std::string s;
-    for (std::string s; std::getline(fs, s, ','); )
+    for (; ; )
     {
-        auto i = std::stoll(s);
+        auto state = process();
+        c.output().clear();
 
-        values->push_back(i);
+        if (state != Computer::WaitingForOutput)
+        {
+            return state;
+        }
     }
 }
 
-enum class ParameterMode : uint8_t
-{
-    PositionMode,
-    ImmediateMode,
-    RelativeMode,
-};
-
-struct Instruction
-{
-    uint8_t opcode;
-    ParameterMode param1Mode;
-    ParameterMode param2Mode;
-    ParameterMode param3Mode;
-};
-
-class Computer
+// Runs the program non-interactively with a single input value and reports
+// the interpreter throughput on stderr.
+void benchmark(const std::vector<int64_t> & program, int64_t input, int repetitions, bool jit)
 {
-public:
-    enum OpCode
-    {
-        Add = 1,
-        Multiply = 2,
-        Input = 3,
-        Output = 4,
-        JumpIfTrue = 5,
-        JumpIfFalse = 6,
-        LessThan = 7,
-        Equals = 8,
-        RelativeBaseOffset = 9,
-
-        Halt = 99,
-    };
-
-    Computer(std::vector<int64_t> instructions)
-        : m_memory(1'000'000)
-        , m_baseOffset(0)
-    {
-        std::copy(instructions.begin(), instructions.end(), m_memory.begin());
-    }
-
-    ~Computer() = default;
-
-    Instruction decode_instruction(int64_t code)
-    {
-        Instruction instruction;
-        instruction.opcode = static_cast<OpCode>(code % 100);
-        instruction.param1Mode = static_cast<ParameterMode>((code / 100) % 10);
-        instruction.param2Mode = static_cast<ParameterMode>((code / 1'000) % 10);
-        instruction.param3Mode = static_cast<ParameterMode>((code / 10'000) & 10);
-
-        return instruction;
-    }
+    uint64_t instructions = 0;
 
-    int64_t evaluate_parameter(int64_t value, ParameterMode mode)
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < repetitions; ++i)
     {
-        int64_t param = 99;
+        Computer c(program);
+        c.push_input(input);
 
-        switch (mode)
+        if (jit)
         {
-            case ParameterMode::PositionMode:  { param = m_memory[value]; } break;
-            case ParameterMode::ImmediateMode: { param = value;           } break;
-            case ParameterMode::RelativeMode:  { param = m_memory[m_baseOffset + value]; } break;
+            Jit j(c);
+            run_discarding_output(c, [&j]() { return j.process(); });
         }
-
-        return param;
-    }
-
-    int64_t evaluate_output(int64_t value, ParameterMode mode)
-    {
-        int64_t param = 0;
-
-        switch (mode)
+        else
         {
-            case ParameterMode::PositionMode:  { param = value;                } break;
-            // case ParameterMode::ImmediateMode: { param = value;                } break;
-            case ParameterMode::RelativeMode:  { param = m_baseOffset + value; } break;
+#if defined(INTCODE_AOT_PROGRAM)
+            Aot aot(c, INTCODE_AOT_PROGRAM);
+            run_discarding_output(c, [&aot]() { return aot.process(); });
+#else
+            run_discarding_output(c, [&c]() { return c.process(); });
+#endif
         }
 
-        return param;
+        instructions += c.instructions_executed();
     }
+    auto end = std::chrono::steady_clock::now();
 
-    void process()
-    {
-        for (int i = 0; ; )
-        {
-            auto inst = decode_instruction(m_memory[i]);
-            switch (inst.opcode)
-            {
-                case Add:
-                {
-                    auto op1 = evaluate_parameter(m_memory[i + 1], inst.param1Mode);
-                    auto op2 = evaluate_parameter(m_memory[i + 2], inst.param2Mode);
-                    auto result = evaluate_output(m_memory[i + 3], inst.param3Mode);
-
-                    m_memory[result] = op1 + op2;
-
-                    i += 4;
-                } break;
-                case Multiply:
-                {
-                    auto op1 = evaluate_parameter(m_memory[i + 1], inst.param1Mode);
-                    auto op2 = evaluate_parameter(m_memory[i + 2], inst.param2Mode);
-                    auto result = evaluate_output(m_memory[i + 3], inst.param3Mode);
-
-                    m_memory[result] = op1 * op2;
-
-                    i += 4;
-                } break;
-                case Input:
-                {
-                    // Opcode 3 takes a single integer as input and saves it to the position
-                    // given by its only parameter. For example, the instruction 3,50 would
-                    // take an input value and store it at address 50.
-                    auto adr = evaluate_output(m_memory[i + 1], inst.param1Mode);
-
-                    int value = 0;
-                    std::cout << "Enter input:";
-                    std::cin >> value;
-
-                    m_memory[adr] = value;
-
-                    i += 2;
-                } break;
-                case Output:
-                {
-                    // Opcode 4 outputs the value of its only parameter. For example,
-                    // the instruction 4,50 would output the value at address 50.
-                    auto val = evaluate_parameter(m_memory[i + 1], inst.param1Mode);
-
-                    std::cout << val << std::endl;
-
-                    i += 2;
-                } break;
-                case JumpIfTrue:
-                {
-                    auto op1 = evaluate_parameter(m_memory[i + 1], inst.param1Mode);
-                    auto op2 = evaluate_parameter(m_memory[i + 2], inst.param2Mode);
-
-                    if (op1 != 0)
-                    {
-                        i = op2;
-                    }
-                    else
-                    {
-                        i += 3;
-                    }
-                } break;
-                case JumpIfFalse:
-                {
-                    auto op1 = evaluate_parameter(m_memory[i + 1], inst.param1Mode);
-                    auto op2 = evaluate_parameter(m_memory[i + 2], inst.param2Mode);
-
-                    if (op1 == 0)
-                    {
-                        i = op2;
-                    }
-                    else
-                    {
-                        i += 3;
-                    }
-                } break;
-                case LessThan:
-                {
-                    auto op1 = evaluate_parameter(m_memory[i + 1], inst.param1Mode);
-                    auto op2 = evaluate_parameter(m_memory[i + 2], inst.param2Mode);
-                    auto result = evaluate_output(m_memory[i + 3], inst.param3Mode);
-
-                    m_memory[result] = (op1 < op2) ? 1 : 0;
-
-                    i += 4;
-                } break;
-                case Equals:
-                {
-                    auto op1 = evaluate_parameter(m_memory[i + 1], inst.param1Mode);
-                    auto op2 = evaluate_parameter(m_memory[i + 2], inst.param2Mode);
-                    auto result = evaluate_output(m_memory[i + 3], inst.param3Mode);
-
-                    m_memory[result] = (op1 == op2) ? 1 : 0;
-
-                    i += 4;
-                } break;
-                case RelativeBaseOffset:
-                {
-                    m_baseOffset += evaluate_parameter(m_memory[i + 1], inst.param1Mode);
-
-                    i += 2;
-                } break;
-                case Halt:
-                {
-                    return;
-                } break;
-                default:
-                {
-                    return;
-                } break;
-            }
-        }
-    }
+    auto seconds = std::chrono::duration<double>(end - start).count();
+
+#if defined(INTCODE_AOT_PROGRAM)
+    auto mode = jit ? "jit" : "aot";
+#else
+    auto mode = jit ? "jit" : Computer::dispatch_mode();
+#endif
 
-private:
-    int64_t m_baseOffset;
-    std::vector<int64_t> m_memory;
-};
+    std::cerr << mode << ": "
+              << instructions << " instructions in " << seconds << " s ("
+              << (instructions / seconds) << " instructions/s)" << std::endl;
+}
 
 int main(int argc, char * argv[])
 {
@@ -234,10 +96,29 @@ int main(int argc, char * argv[])
     auto filename = argv[1];
 
     std::vector<int64_t> program;
-    read_input(filename, &program);
+    read_program(filename, &program);
+
+    // NOTE: `day-9 <input> <value> <repetitions> [jit]` benchmarks the
+    // interpreter, or the JIT when the last argument is given.
+    if (argc >= 4)
+    {
+        benchmark(program, std::stoll(argv[2]), std::stoi(argv[3]), argc >= 5 && std::string(argv[4]) == "jit");
+
+        return 0;
+    }
 
     Computer c(program);
-    c.process();
+
+#if defined(INTCODE_AOT_PROGRAM)
+    Aot aot(c, INTCODE_AOT_PROGRAM);
+    run_interactive(c, [&aot]() { return aot.process(); });
+#elif defined(INTCODE_PROFILE)
+    Profiler profiler;
+    run_interactive(c, [&c, &profiler]() { return c.process(profiler); });
+    profiler.report(std::cerr, c);
+#else
+    run_interactive(c);
+#endif
 
     return 0;
 }
@@ -0,0 +1,143 @@
+#ifndef INTCODE_AOT_H
+#define INTCODE_AOT_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "computer.h"
+#include "program.h"
+
+class Aot;
+
+// Wrapping arithmetic for generated code, so the C++ compiler cannot assume
+// Intcode arithmetic never overflows.
+inline int64_t aot_add(int64_t a, int64_t b)
+{
+    return static_cast<int64_t>(static_cast<uint64_t>(a) + static_cast<uint64_t>(b));
+}
+
+inline int64_t aot_mul(int64_t a, int64_t b)
+{
+    return static_cast<int64_t>(static_cast<uint64_t>(a) * static_cast<uint64_t>(b));
+}
+
+// Describes a program translated ahead of time by tools/intcode2cpp. The
+// generated translation unit defines one of these for each program.
+struct CompiledProgram
+{
+    const char * name;
+    size_t size;
+    uint64_t checksum;
+    Computer::State (*run)(Aot & vm);
+};
+
+// Runs a computer through the C++ translation of its program. The generated
+// code resumes at any known instruction address, so waiting for input and
+// resuming work exactly as in the interpreter. If the program writes to its
+// own code, or jumps somewhere the translator never saw, the machine is handed
+// to the interpreter for good. Attach it before the machine starts running,
+// while memory still holds the program the code was generated from.
+class Aot
+{
+public:
+    Aot(Computer & computer, const CompiledProgram & program)
+        : m_computer(computer)
+        , m_program(program)
+        , m_deoptimized(!matches(computer, program))
+    {}
+
+    bool deoptimized() const
+    {
+        return m_deoptimized;
+    }
+
+    Computer::State process()
+    {
+        if (m_deoptimized)
+        {
+            return m_computer.process();
+        }
+
+        m_computer.m_started = true;
+
+        return m_program.run(*this);
+    }
+
+    // The rest of the interface is used by the generated code.
+
+    int64_t pc() const
+    {
+        return m_computer.m_pc;
+    }
+
+    int64_t base() const
+    {
+        return m_computer.m_baseOffset;
+    }
+
+    // Whether an address only known at run time is inside memory. The
+    // generated code asks before an instruction has any effect, and hands an
+    // instruction that fails to the interpreter, which reports it as invalid.
+    bool in_range(int64_t address) const
+    {
+        return static_cast<uint64_t>(address) < m_computer.m_memory.size();
+    }
+
+    int64_t load(int64_t address) const
+    {
+        return m_computer.m_memory.read(address);
+    }
+
+    void store(int64_t address, int64_t value)
+    {
+        m_computer.write(address, value);
+    }
+
+    bool input(int64_t * value)
+    {
+        return m_computer.input().pop(value);
+    }
+
+    bool output(int64_t value)
+    {
+        return m_computer.output().push(value);
+    }
+
+    Computer::State suspend(int64_t pc, int64_t base, uint64_t executed, Computer::State state)
+    {
+        m_computer.m_pc = pc;
+        m_computer.m_baseOffset = base;
+        m_computer.m_executed += executed;
+
+        if (state == Computer::Halted)
+        {
+            m_computer.m_halted = true;
+        }
+
+        return state;
+    }
+
+    Computer::State deoptimize(int64_t pc, int64_t base, uint64_t executed)
+    {
+        m_computer.m_pc = pc;
+        m_computer.m_baseOffset = base;
+        m_computer.m_executed += executed;
+        m_deoptimized = true;
+
+        return m_computer.process();
+    }
+
+private:
+    static bool matches(const Computer & computer, const CompiledProgram & program)
+    {
+        return computer.m_decoded.size() == program.size
+            && computer.m_memory.extent() >= program.size
+            && program_checksum(computer.m_memory.data(), program.size) == program.checksum;
+    }
+
+    Computer & m_computer;
+    const CompiledProgram & m_program;
+    bool m_deoptimized;
+};
+
+#endif
@@ -0,0 +1,597 @@
+#ifndef INTCODE_BATCH_H
+#define INTCODE_BATCH_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#if defined(__AVX2__)
+    #include <immintrin.h>
+#endif
+
+#include "computer.h"
+#include "instruction.h"
+#include "memory.h"
+#include "ring_buffer.h"
+
+// Runs kLanes copies of one program in lockstep, for sweeps that run the same
+// code on many inputs. Every lane has its own registers, memory and I/O, but
+// memory is interleaved by address (all lanes' copies of word N sit next to
+// each other), so one instruction executed on all lanes at once touches
+// contiguous memory whenever the lanes agree on an address.
+//
+// Each step picks the lowest program counter among the lanes that can run,
+// and executes that instruction on every lane that is there with the same
+// opcode word; the others are masked off and wait their turn. Lanes that
+// branch apart therefore split into groups, and they merge again as soon as
+// they reach the same address. Operands are loaded with AVX2 gathers and the
+// arithmetic runs on AVX2 when the build targets it (-mavx2 or -march=native),
+// and on plain loops over the lanes otherwise.
+template <size_t kLanes = 8>
+class BatchComputer
+{
+    static_assert(kLanes >= 4 && kLanes <= 32 && (kLanes & (kLanes - 1)) == 0,
+                  "Lanes must be a power of two between 4 and 32");
+
+public:
+    // One bit per lane.
+    using Mask = uint32_t;
+
+    using Port = RingBuffer<int64_t, 64>;
+
+    // Each lane gets as much memory as the interpreter by default; pages no
+    // lane touches cost nothing.
+    BatchComputer(const std::vector<int64_t> & program, size_t memorySize = Memory::kDefaultSize)
+        : m_size(std::max(memorySize, program.size()))
+        , m_memory(m_size)
+        , m_extent(0)
+        , m_decoded(program.size())
+        , m_decodedWord(program.size())
+        , m_steps(0)
+        , m_executed(0)
+    {
+        load(program);
+    }
+
+    ~BatchComputer() = default;
+
+    static constexpr size_t lanes()
+    {
+        return kLanes;
+    }
+
+    static const char * simd_mode()
+    {
+#if defined(__AVX2__)
+        return "avx2";
+#else
+        return "scalar";
+#endif
+    }
+
+    // Puts every lane back at the start of the program, with empty ports.
+    void load(const std::vector<int64_t> & program)
+    {
+        std::fill(m_memory.begin(), m_memory.begin() + m_extent, Row{});
+
+        for (size_t i = 0; i < program.size(); ++i)
+        {
+            std::fill(std::begin(m_memory[i].lane), std::end(m_memory[i].lane), program[i]);
+        }
+
+        m_extent = program.size();
+
+        for (size_t lane = 0; lane < kLanes; ++lane)
+        {
+            m_pc[lane] = 0;
+            m_base[lane] = 0;
+            m_state[lane] = Computer::Suspended;
+            m_input[lane].clear();
+            m_output[lane].clear();
+        }
+    }
+
+    int64_t read(size_t lane, int64_t address) const
+    {
+        return m_memory[address].lane[lane];
+    }
+
+    void write(size_t lane, int64_t address, int64_t value)
+    {
+        m_memory[address].lane[lane] = value;
+        m_extent = std::max<size_t>(m_extent, address + 1);
+    }
+
+    bool push_input(size_t lane, int64_t value)
+    {
+        return m_input[lane].push(value);
+    }
+
+    bool pop_output(size_t lane, int64_t * value)
+    {
+        return m_output[lane].pop(value);
+    }
+
+    // Suspended while the lane can still run, otherwise why it stopped.
+    Computer::State state(size_t lane) const
+    {
+        return m_state[lane];
+    }
+
+    // Lockstep steps taken, and instructions executed summed over the lanes.
+    // Their ratio over kLanes is how well the lanes stayed together.
+    uint64_t steps() const
+    {
+        return m_steps;
+    }
+
+    uint64_t instructions_executed() const
+    {
+        return m_executed;
+    }
+
+    // Runs until no lane can make progress: every lane has stopped or is
+    // blocked on its ports. Call it again after feeding or draining them.
+    void process()
+    {
+        Mask running = 0;
+        for (size_t lane = 0; lane < kLanes; ++lane)
+        {
+            auto state = m_state[lane];
+            if (state == Computer::Suspended
+                || (state == Computer::WaitingForInput && !m_input[lane].empty())
+                || (state == Computer::WaitingForOutput && !m_output[lane].full()))
+            {
+                m_state[lane] = Computer::Suspended;
+                running |= Mask(1) << lane;
+            }
+        }
+
+        while (running)
+        {
+            auto active = select(running);
+            auto leader = static_cast<size_t>(__builtin_ctz(active));
+            auto pc = m_pc[leader];
+
+            const Instruction * inst = nullptr;
+            if (pc >= 0 && static_cast<size_t>(pc) < m_decoded.size())
+            {
+                inst = &fetch(pc, m_memory[pc].lane[leader]);
+            }
+
+            // NOTE: Code outside the program, or truncated by the end of
+            // memory, is not supported in lockstep.
+            if (!inst || inst->opcode == Undecoded || pc + inst->length > static_cast<int64_t>(m_size))
+            {
+                running &= ~stop(active, Computer::InvalidInstruction);
+                continue;
+            }
+
+            // Lanes whose code has been changed under them wait for a step of
+            // their own.
+            const auto & code = m_memory[pc];
+            for (auto rest = active & ~(Mask(1) << leader); rest; rest &= rest - 1)
+            {
+                auto lane = static_cast<size_t>(__builtin_ctz(rest));
+                if (code.lane[lane] != code.lane[leader])
+                {
+                    active &= ~(Mask(1) << lane);
+                }
+            }
+
+            ++m_steps;
+            m_executed += static_cast<uint64_t>(__builtin_popcount(active));
+
+            running &= ~execute(*inst, pc, active);
+        }
+    }
+
+private:
+    struct alignas(32) Row
+    {
+        int64_t lane[kLanes];
+    };
+
+    // The lanes that run next: those at the lowest program counter.
+    Mask select(Mask running) const
+    {
+        auto pc = std::numeric_limits<int64_t>::max();
+        for (auto rest = running; rest; rest &= rest - 1)
+        {
+            pc = std::min(pc, m_pc[__builtin_ctz(rest)]);
+        }
+
+        Mask active = 0;
+        for (auto rest = running; rest; rest &= rest - 1)
+        {
+            auto lane = __builtin_ctz(rest);
+            if (m_pc[lane] == pc)
+            {
+                active |= Mask(1) << lane;
+            }
+        }
+
+        return active;
+    }
+
+    const Instruction & fetch(int64_t pc, int64_t word)
+    {
+        auto & inst = m_decoded[pc];
+        if (inst.opcode == Undecoded || m_decodedWord[pc] != word)
+        {
+            int64_t code[kMaxInstructionLength] = {};
+            auto available = std::min<int64_t>(kMaxInstructionLength, m_size - pc);
+            for (int64_t i = 0; i < available; ++i)
+            {
+                code[i] = m_memory[pc + i].lane[0];
+            }
+            code[0] = word;
+
+            // NOTE: Only the opcode and the modes are used; the parameters
+            // are read from every lane's own memory.
+            inst = decode_instruction(code, available);
+            m_decodedWord[pc] = word;
+        }
+
+        return inst;
+    }
+
+    // Stops the lanes in `lanes` and returns them.
+    Mask stop(Mask lanes, Computer::State state)
+    {
+        for (auto rest = lanes; rest; rest &= rest - 1)
+        {
+            m_state[__builtin_ctz(rest)] = state;
+        }
+
+        return lanes;
+    }
+
+    // Loads parameter `index` of the instruction at `pc` as an operand on the
+    // active lanes. Lanes that read outside memory are added to `faults`.
+    void operand(int64_t pc, int index, ParameterMode mode, Mask active, Row * value, Mask * faults) const
+    {
+        const auto & param = m_memory[pc + 1 + index];
+        if (mode == ParameterMode::ImmediateMode)
+        {
+            *value = param;
+
+            return;
+        }
+
+        Row address = param;
+        if (mode == ParameterMode::RelativeMode)
+        {
+            add(address, base_row(), &address);
+        }
+
+        *faults |= gather(address, active, value);
+    }
+
+    // Computes the store address of parameter `index` on every lane.
+    Row destination(int64_t pc, int index, ParameterMode mode) const
+    {
+        Row address = m_memory[pc + 1 + index];
+        if (mode == ParameterMode::RelativeMode)
+        {
+            add(address, base_row(), &address);
+        }
+
+        return address;
+    }
+
+    Row base_row() const
+    {
+        Row base;
+        std::copy(std::begin(m_base), std::end(m_base), base.lane);
+
+        return base;
+    }
+
+    // Writes one value per active lane, returning the lanes that wrote
+    // outside memory. AVX2 has no scatter, so this is a loop either way.
+    Mask scatter(const Row & address, const Row & value, Mask active)
+    {
+        Mask faults = 0;
+        for (auto rest = active; rest; rest &= rest - 1)
+        {
+            auto lane = __builtin_ctz(rest);
+            auto a = address.lane[lane];
+            if (a < 0 || a >= static_cast<int64_t>(m_size))
+            {
+                faults |= Mask(1) << lane;
+                continue;
+            }
+
+            m_memory[a].lane[lane] = value.lane[lane];
+            m_extent = std::max<size_t>(m_extent, a + 1);
+        }
+
+        return faults;
+    }
+
+    // Runs one instruction on the active lanes and returns the lanes that
+    // stopped: those blocked on a port and those that touched memory outside
+    // their own.
+    Mask execute(const Instruction & inst, int64_t pc, Mask active)
+    {
+        Mask faults = 0;
+        Mask blocked = 0;
+        Row op1;
+        Row op2;
+        Row result;
+
+        switch (inst.opcode)
+        {
+            case Add:
+            case Multiply:
+            case LessThan:
+            case Equals:
+            {
+                operand(pc, 0, inst.param1Mode, active, &op1, &faults);
+                operand(pc, 1, inst.param2Mode, active, &op2, &faults);
+
+                switch (inst.opcode)
+                {
+                    case Add:      { add(op1, op2, &result);        } break;
+                    case Multiply: { multiply(op1, op2, &result);   } break;
+                    case LessThan: { less_than(op1, op2, &result);  } break;
+                    default:       { equals(op1, op2, &result);     } break;
+                }
+
+                faults |= scatter(destination(pc, 2, inst.param3Mode), result, active & ~faults);
+                advance(active, 4);
+            } break;
+            case Input:
+            {
+                auto address = destination(pc, 0, inst.param1Mode);
+
+                for (auto rest = active; rest; rest &= rest - 1)
+                {
+                    auto lane = static_cast<size_t>(__builtin_ctz(rest));
+                    if (!m_input[lane].pop(&result.lane[lane]))
+                    {
+                        blocked |= Mask(1) << lane;
+                    }
+                }
+
+                if (blocked)
+                {
+                    // NOTE: Not executed after all; they retry on the next call.
+                    m_executed -= static_cast<uint64_t>(__builtin_popcount(blocked));
+                    active &= ~stop(blocked, Computer::WaitingForInput);
+                }
+
+                faults |= scatter(address, result, active);
+                advance(active, 2);
+            } break;
+            case Output:
+            {
+                operand(pc, 0, inst.param1Mode, active, &op1, &faults);
+
+                for (auto rest = active & ~faults; rest; rest &= rest - 1)
+                {
+                    auto lane = static_cast<size_t>(__builtin_ctz(rest));
+                    if (!m_output[lane].push(op1.lane[lane]))
+                    {
+                        blocked |= Mask(1) << lane;
+                    }
+                }
+
+                if (blocked)
+                {
+                    m_executed -= static_cast<uint64_t>(__builtin_popcount(blocked));
+                    active &= ~stop(blocked, Computer::WaitingForOutput);
+                }
+
+                advance(active, 2);
+            } break;
+            case JumpIfTrue:
+            case JumpIfFalse:
+            {
+                operand(pc, 0, inst.param1Mode, active, &op1, &faults);
+                operand(pc, 1, inst.param2Mode, active, &op2, &faults);
+
+                auto jumpIfTrue = inst.opcode == JumpIfTrue;
+                for (auto rest = active; rest; rest &= rest - 1)
+                {
+                    auto lane = __builtin_ctz(rest);
+                    m_pc[lane] = ((op1.lane[lane] != 0) == jumpIfTrue) ? op2.lane[lane] : pc + 3;
+                }
+            } break;
+            case RelativeBaseOffset:
+            {
+                operand(pc, 0, inst.param1Mode, active, &op1, &faults);
+
+                for (auto rest = active; rest; rest &= rest - 1)
+                {
+                    auto lane = __builtin_ctz(rest);
+                    m_base[lane] += op1.lane[lane];
+                }
+
+                advance(active, 2);
+            } break;
+            case Halt:
+            {
+                return stop(active, Computer::Halted);
+            } break;
+            default:
+            {
+                return stop(active, Computer::InvalidInstruction);
+            } break;
+        }
+
+        return stop(faults, Computer::InvalidInstruction) | blocked;
+    }
+
+    void advance(Mask active, int64_t length)
+    {
+        for (auto rest = active; rest; rest &= rest - 1)
+        {
+            m_pc[__builtin_ctz(rest)] += length;
+        }
+    }
+
+#if defined(__AVX2__)
+    static __m256i load4(const Row & row, size_t chunk)
+    {
+        return _mm256_load_si256(reinterpret_cast<const __m256i *>(row.lane + 4 * chunk));
+    }
+
+    static void store4(Row * row, size_t chunk, __m256i value)
+    {
+        _mm256_store_si256(reinterpret_cast<__m256i *>(row->lane + 4 * chunk), value);
+    }
+
+    // All ones in every 64-bit element whose lane bit is set.
+    static __m256i mask4(Mask mask, size_t chunk)
+    {
+        auto bits = _mm256_set1_epi64x((mask >> (4 * chunk)) & 0xF);
+        auto select = _mm256_setr_epi64x(1, 2, 4, 8);
+
+        return _mm256_cmpeq_epi64(_mm256_and_si256(bits, select), select);
+    }
+
+    // AVX2 has no 64-bit multiply, so it is built from 32-bit products:
+    // lo(a)*lo(b) + ((lo(a)*hi(b) + hi(a)*lo(b)) << 32), modulo 2^64.
+    static __m256i multiply4(__m256i a, __m256i b)
+    {
+        auto swapped = _mm256_shuffle_epi32(b, 0xB1);
+        auto cross = _mm256_mullo_epi32(a, swapped);
+        auto sums = _mm256_hadd_epi32(cross, _mm256_setzero_si256());
+        auto high = _mm256_shuffle_epi32(sums, 0x73);
+        auto low = _mm256_mul_epu32(a, b);
+
+        return _mm256_add_epi64(low, high);
+    }
+
+    Mask gather(const Row & address, Mask active, Row * value) const
+    {
+        auto memory = reinterpret_cast<const long long *>(m_memory.data());
+        auto size = _mm256_set1_epi64x(static_cast<long long>(m_size));
+        auto offsets = _mm256_setr_epi64x(0, 1, 2, 3);
+
+        Mask faults = 0;
+        for (size_t chunk = 0; chunk < kLanes / 4; ++chunk)
+        {
+            auto a = load4(address, chunk);
+            auto inside = _mm256_andnot_si256(_mm256_cmpgt_epi64(_mm256_setzero_si256(), a), _mm256_cmpgt_epi64(size, a));
+            auto lanes = mask4(active, chunk);
+            auto load = _mm256_and_si256(lanes, inside);
+
+            auto index = _mm256_add_epi64(_mm256_slli_epi64(a, kShift), _mm256_add_epi64(offsets, _mm256_set1_epi64x(4 * chunk)));
+            store4(value, chunk, _mm256_mask_i64gather_epi64(_mm256_setzero_si256(), memory, index, load, 8));
+
+            auto bad = _mm256_andnot_si256(inside, lanes);
+            faults |= static_cast<Mask>(_mm256_movemask_pd(_mm256_castsi256_pd(bad))) << (4 * chunk);
+        }
+
+        return faults;
+    }
+
+    static void add(const Row & a, const Row & b, Row * result)
+    {
+        for (size_t chunk = 0; chunk < kLanes / 4; ++chunk)
+        {
+            store4(result, chunk, _mm256_add_epi64(load4(a, chunk), load4(b, chunk)));
+        }
+    }
+
+    static void multiply(const Row & a, const Row & b, Row * result)
+    {
+        for (size_t chunk = 0; chunk < kLanes / 4; ++chunk)
+        {
+            store4(result, chunk, multiply4(load4(a, chunk), load4(b, chunk)));
+        }
+    }
+
+    static void less_than(const Row & a, const Row & b, Row * result)
+    {
+        for (size_t chunk = 0; chunk < kLanes / 4; ++chunk)
+        {
+            store4(result, chunk, _mm256_srli_epi64(_mm256_cmpgt_epi64(load4(b, chunk), load4(a, chunk)), 63));
+        }
+    }
+
+    static void equals(const Row & a, const Row & b, Row * result)
+    {
+        for (size_t chunk = 0; chunk < kLanes / 4; ++chunk)
+        {
+            store4(result, chunk, _mm256_srli_epi64(_mm256_cmpeq_epi64(load4(a, chunk), load4(b, chunk)), 63));
+        }
+    }
+#else
+    Mask gather(const Row & address, Mask active, Row * value) const
+    {
+        Mask faults = 0;
+        for (size_t lane = 0; lane < kLanes; ++lane)
+        {
+            auto a = address.lane[lane];
+            if (a < 0 || a >= static_cast<int64_t>(m_size))
+            {
+                faults |= (active & (Mask(1) << lane));
+                value->lane[lane] = 0;
+                continue;
+            }
+
+            value->lane[lane] = m_memory[a].lane[lane];
+        }
+
+        return faults;
+    }
+
+    static void add(const Row & a, const Row & b, Row * result)
+    {
+        for (size_t lane = 0; lane < kLanes; ++lane)
+        {
+            result->lane[lane] = static_cast<int64_t>(static_cast<uint64_t>(a.lane[lane]) + static_cast<uint64_t>(b.lane[lane]));
+        }
+    }
+
+    static void multiply(const Row & a, const Row & b, Row * result)
+    {
+        for (size_t lane = 0; lane < kLanes; ++lane)
+        {
+            result->lane[lane] = static_cast<int64_t>(static_cast<uint64_t>(a.lane[lane]) * static_cast<uint64_t>(b.lane[lane]));
+        }
+    }
+
+    static void less_than(const Row & a, const Row & b, Row * result)
+    {
+        for (size_t lane = 0; lane < kLanes; ++lane)
+        {
+            result->lane[lane] = (a.lane[lane] < b.lane[lane]) ? 1 : 0;
+        }
+    }
+
+    static void equals(const Row & a, const Row & b, Row * result)
+    {
+        for (size_t lane = 0; lane < kLanes; ++lane)
+        {
+            result->lane[lane] = (a.lane[lane] == b.lane[lane]) ? 1 : 0;
+        }
+    }
+#endif
+
+    static constexpr int kShift = __builtin_ctz(kLanes);
+
+    size_t m_size;
+    std::vector<Row, PageAllocator<Row>> m_memory;
+    size_t m_extent;
+
+    std::vector<Instruction> m_decoded;
+    std::vector<int64_t> m_decodedWord;
+
+    int64_t m_pc[kLanes];
+    int64_t m_base[kLanes];
+    Computer::State m_state[kLanes];
+    Port m_input[kLanes];
+    Port m_output[kLanes];
+
+    uint64_t m_steps;
+    uint64_t m_executed;
+};
+
+#endif
@@ -0,0 +1,347 @@
+#ifndef INTCODE_CHECKPOINT_H
+#define INTCODE_CHECKPOINT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <new>
+#include <string>
+#include <vector>
+
+#if !defined(_WIN32)
+    #include <fcntl.h>
+    #include <unistd.h>
+#endif
+
+#include "computer.h"
+#include "memory.h"
+
+// Saves a machine to disk and brings it back later, possibly in another
+// process. A checkpoint holds the registers, the pending input and output and
+// every page of memory that holds anything but zeros:
+//
+//     header | input | output | page numbers | padding | pages
+//
+// The pages start on a page boundary, so a restore maps them straight from
+// the file, copy-on-write, instead of reading them in. Checkpoints use the
+// native byte order and are meant to be restored on the machine that wrote
+// them.
+class Checkpoint
+{
+public:
+    static constexpr uint32_t kVersion = 1;
+
+    // Far more than any machine is given, and small enough that the size of
+    // its memory in bytes cannot overflow.
+    static constexpr uint64_t kMaxMemoryWords = uint64_t(1) << 40;
+
+    // Writes the machine's state to `filename`. The file is written under a
+    // temporary name, synced to disk and then renamed, and the rename is
+    // synced as well, so a crash or a power loss part way through leaves
+    // either the previous checkpoint or the new one.
+    //
+    // NOTE: On Windows nothing is synced, and the previous checkpoint is
+    // removed before the rename, so only a crash of the process itself is
+    // covered.
+    template <typename Features, typename IO>
+    static bool save(const BasicComputer<Features, IO> & computer, const char * filename)
+    {
+        auto & memory = computer.m_memory;
+        auto page = Memory::page_size();
+
+        std::vector<uint64_t> pages;
+        auto used = (memory.extent() * sizeof(int64_t) + page - 1) / page;
+        for (size_t i = 0; i < used; ++i)
+        {
+            if (memory.page_touched(i))
+            {
+                pages.push_back(i);
+            }
+        }
+
+        std::vector<int64_t> input;
+        std::vector<int64_t> output;
+        if constexpr (IO::kEnabled)
+        {
+            input = drain(computer.input());
+            output = drain(computer.output());
+        }
+
+        Header header{};
+        std::memcpy(header.magic, kMagic, sizeof(header.magic));
+        header.version = kVersion;
+        header.pageSize = static_cast<uint32_t>(page);
+        header.started = computer.m_started;
+        header.halted = computer.m_halted;
+        header.pc = computer.m_pc;
+        header.baseOffset = computer.m_baseOffset;
+        header.executed = computer.m_executed;
+        header.memoryWords = memory.size();
+        header.extent = memory.extent();
+        header.programWords = computer.m_decoded.size();
+        header.inputCount = input.size();
+        header.outputCount = output.size();
+        header.pageCount = pages.size();
+
+        auto tables = sizeof(Header) + (input.size() + output.size() + pages.size()) * sizeof(uint64_t);
+        header.dataOffset = ((tables + page - 1) / page) * page;
+
+        auto temporary = std::string(filename) + ".tmp";
+        {
+            std::ofstream fs(temporary, std::ofstream::binary | std::ofstream::trunc);
+
+            fs.write(reinterpret_cast<const char *>(&header), sizeof(header));
+            fs.write(reinterpret_cast<const char *>(input.data()), input.size() * sizeof(int64_t));
+            fs.write(reinterpret_cast<const char *>(output.data()), output.size() * sizeof(int64_t));
+            fs.write(reinterpret_cast<const char *>(pages.data()), pages.size() * sizeof(uint64_t));
+
+            std::vector<char> padding(header.dataOffset - tables, 0);
+            fs.write(padding.data(), padding.size());
+
+            auto data = reinterpret_cast<const char *>(memory.data());
+            for (auto i : pages)
+            {
+                fs.write(data + i * page, page);
+            }
+
+            if (!fs.flush())
+            {
+                std::remove(temporary.c_str());
+
+                return false;
+            }
+        }
+
+        if (!sync(temporary.c_str()))
+        {
+            std::remove(temporary.c_str());
+
+            return false;
+        }
+
+#if defined(_WIN32)
+        // NOTE: Windows refuses to rename over an existing file.
+        std::remove(filename);
+#endif
+
+        if (std::rename(temporary.c_str(), filename) != 0)
+        {
+            return false;
+        }
+
+        auto directory = std::filesystem::path(filename).parent_path();
+
+        return sync(directory.empty() ? "." : directory.c_str());
+    }
+
+    // Replaces the machine's state with the one saved in `filename`, which
+    // may have been saved from a machine with other policies. The decode
+    // cache starts out empty, so whatever this machine lacks is rejected as
+    // the code is decoded again. A machine without ports cannot take pending
+    // input or output, though. Restore a machine before attaching a
+    // JIT to it, not after. Returns false, leaving the machine untouched, if
+    // the file is missing, is not a checkpoint, is shorter than its header
+    // says or describes a machine that does not fit in its own memory, or in
+    // this host's.
+    template <typename Features, typename IO>
+    static bool restore(BasicComputer<Features, IO> * computer, const char * filename)
+    {
+        using Vm = BasicComputer<Features, IO>;
+
+        std::ifstream fs(filename, std::ifstream::binary);
+
+        Header header{};
+        if (!fs.read(reinterpret_cast<char *>(&header), sizeof(header))
+            || std::memcmp(header.magic, kMagic, sizeof(header.magic)) != 0
+            || header.version != kVersion
+            || header.inputCount > Computer::kPortCapacity
+            || header.outputCount > Computer::kPortCapacity
+            || (!IO::kEnabled && (header.inputCount > 0 || header.outputCount > 0))
+            || header.pageSize == 0
+            || !fits(fs, header)
+            || header.memoryWords > kMaxMemoryWords
+            || header.extent > header.memoryWords
+            || header.programWords > header.memoryWords
+            || static_cast<uint64_t>(header.pc) > header.memoryWords)
+        {
+            return false;
+        }
+
+        std::vector<int64_t> input(header.inputCount);
+        std::vector<int64_t> output(header.outputCount);
+        std::vector<uint64_t> pages(header.pageCount);
+        fs.read(reinterpret_cast<char *>(input.data()), input.size() * sizeof(int64_t));
+        fs.read(reinterpret_cast<char *>(output.data()), output.size() * sizeof(int64_t));
+        fs.read(reinterpret_cast<char *>(pages.data()), pages.size() * sizeof(uint64_t));
+        if (!fs)
+        {
+            return false;
+        }
+
+        Memory memory(0);
+        try
+        {
+            memory = Memory(header.memoryWords);
+        }
+        catch (const std::bad_alloc &)
+        {
+            return false;
+        }
+
+        auto page = static_cast<size_t>(header.pageSize);
+        for (auto i : pages)
+        {
+            if (i >= memory.size() * sizeof(int64_t) / page)
+            {
+                return false;
+            }
+        }
+
+        if (!load_pages(fs, filename, header, pages, &memory))
+        {
+            return false;
+        }
+
+        memory.extend(header.extent);
+
+        computer->m_started = header.started;
+        computer->m_halted = header.halted;
+        computer->m_pc = header.pc;
+        computer->m_baseOffset = header.baseOffset;
+        computer->m_executed = header.executed;
+        computer->m_memory = std::move(memory);
+        computer->m_decoded = typename Vm::DecodeCache(header.programWords);
+        computer->m_codeMap = typename Vm::CodeMap(header.programWords + kMaxInstructionLength - 1);
+
+        if constexpr (IO::kEnabled)
+        {
+            computer->input().clear();
+            computer->input().push(input.data(), input.size());
+            computer->output().clear();
+            computer->output().push(output.data(), output.size());
+        }
+
+        return true;
+    }
+
+private:
+    static constexpr char kMagic[8] = { 'I', 'N', 'T', 'C', 'K', 'P', 'T', '\0' };
+
+    struct Header
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t pageSize;
+        uint8_t started;
+        uint8_t halted;
+        uint8_t reserved[6];
+        int64_t pc;
+        int64_t baseOffset;
+        uint64_t executed;
+        uint64_t memoryWords;
+        uint64_t extent;
+        uint64_t programWords;
+        uint64_t inputCount;
+        uint64_t outputCount;
+        uint64_t pageCount;
+        // Where the first page starts in the file.
+        uint64_t dataOffset;
+    };
+
+    // Flushes a file, or the entries of a directory, to disk.
+    static bool sync(const char * path)
+    {
+#if !defined(_WIN32)
+        auto fd = open(path, O_RDONLY);
+        if (fd < 0)
+        {
+            return false;
+        }
+
+        auto synced = fsync(fd) == 0;
+        close(fd);
+
+        return synced;
+#else
+        (void)path;
+        return true;
+#endif
+    }
+
+    // Whether the file holds every page the header lists. The pages are
+    // mapped, and touching one past the end of the file faults.
+    static bool fits(std::ifstream & fs, const Header & header)
+    {
+        fs.seekg(0, std::ifstream::end);
+        auto fileSize = static_cast<uint64_t>(fs.tellg());
+        fs.seekg(sizeof(Header));
+
+        return fs && header.dataOffset <= fileSize
+            && header.pageCount <= (fileSize - header.dataOffset) / header.pageSize;
+    }
+
+    static std::vector<int64_t> drain(const Computer::Port & port)
+    {
+        auto copy = port;
+
+        std::vector<int64_t> values;
+        for (int64_t value; copy.pop(&value); )
+        {
+            values.push_back(value);
+        }
+
+        return values;
+    }
+
+    // Maps the saved pages into `memory`, one mapping per run of pages that
+    // are consecutive both in memory and in the file. Falls back to reading
+    // them when the file was written with a different page size.
+    static bool load_pages(std::ifstream & fs, const char * filename, const Header & header,
+                           const std::vector<uint64_t> & pages, Memory * memory)
+    {
+        auto page = static_cast<size_t>(header.pageSize);
+
+#if !defined(_WIN32)
+        if (page == Memory::page_size())
+        {
+            auto fd = open(filename, O_RDONLY);
+            if (fd < 0)
+            {
+                return false;
+            }
+
+            // NOTE: The mappings keep the file open after the descriptor is
+            // closed, and clean pages are shared with the page cache.
+            auto mapped = true;
+            for (size_t first = 0, last; mapped && first < pages.size(); first = last)
+            {
+                for (last = first + 1; last < pages.size() && pages[last] == pages[last - 1] + 1; ++last)
+                {
+                }
+
+                mapped = memory->map_file(fd, header.dataOffset + first * page, pages[first], last - first);
+            }
+
+            close(fd);
+
+            return mapped;
+        }
+#else
+        (void)filename;
+#endif
+
+        auto data = reinterpret_cast<char *>(memory->data());
+        fs.seekg(header.dataOffset);
+        for (auto i : pages)
+        {
+            fs.read(data + i * page, page);
+        }
+
+        return static_cast<bool>(fs);
+    }
+};
+
+#endif
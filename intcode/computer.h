@@ -0,0 +1,999 @@
+#ifndef INTCODE_COMPUTER_H
+#define INTCODE_COMPUTER_H
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "instruction.h"
+#include "memory.h"
+#include "program.h"
+#include "ring_buffer.h"
+
+// Selects the dispatch loop at build time. Labels-as-values is a GCC/Clang
+// extension, so every other compiler always gets the switch loop. Build with
+// -DINTCODE_COMPUTED_GOTO=0 to measure the switch loop on GCC/Clang as well.
+#if !defined(__GNUC__) && !defined(__clang__)
+    #undef INTCODE_COMPUTED_GOTO
+    #define INTCODE_COMPUTED_GOTO 0
+#elif !defined(INTCODE_COMPUTED_GOTO)
+    #define INTCODE_COMPUTED_GOTO 1
+#endif
+
+// Fuses a compare followed by a jump on its result into one handler. Build
+// with -DINTCODE_SUPERINSTRUCTIONS=0 to measure without it.
+#if !defined(INTCODE_SUPERINSTRUCTIONS)
+    #define INTCODE_SUPERINSTRUCTIONS 1
+#endif
+
+// The profiling hooks the interpreter calls. This one does nothing and
+// inlines away, so an unprofiled run pays nothing for them; profiler.h has
+// the one that counts.
+struct NullProfiler
+{
+    static constexpr bool kEnabled = false;
+
+    // An instruction at `pc` is about to run.
+    void count(int64_t, uint8_t) {}
+    // The instruction at `pc` stopped for I/O and will run again.
+    void retry(int64_t, uint8_t) {}
+    // The jump at `pc` was or was not taken.
+    void branch(int64_t, bool) {}
+};
+
+// What every machine shares, whatever it was built with, so that code driving
+// machines can handle all of them alike.
+class ComputerBase
+{
+public:
+    enum State
+    {
+        Halted,
+        WaitingForInput,
+        InvalidInstruction,
+        Suspended,
+        WaitingForOutput,
+    };
+
+    // Input and output are fixed-size single-producer/single-consumer queues,
+    // so feeding a machine never allocates, and a driver on another thread
+    // can feed it while it runs. A program that fills its output port stops
+    // with WaitingForOutput until the port has been drained.
+    static constexpr size_t kPortCapacity = 1024;
+
+    using Port = RingBuffer<int64_t, kPortCapacity>;
+};
+
+// The feature policies say which parts of the instruction set a machine
+// runs. Whatever a machine is built without is compiled out of its
+// interpreter, and instructions that need it decode as invalid.
+struct AllFeatures
+{
+    // Parameter mode 2 and opcode 9, added on day 9.
+    static constexpr bool kRelativeMode = true;
+};
+
+// The instruction set before day 9, as days 2, 5 and 7 use it.
+struct BasicFeatures
+{
+    static constexpr bool kRelativeMode = false;
+};
+
+// The I/O policies hold whatever the Input and Output opcodes talk to. This
+// one is the pair of ports described above.
+class PortIO
+{
+public:
+    static constexpr bool kEnabled = true;
+
+    ComputerBase::Port & input()
+    {
+        return m_input;
+    }
+
+    const ComputerBase::Port & input() const
+    {
+        return m_input;
+    }
+
+    ComputerBase::Port & output()
+    {
+        return m_output;
+    }
+
+    const ComputerBase::Port & output() const
+    {
+        return m_output;
+    }
+
+    void clear()
+    {
+        m_input.clear();
+        m_output.clear();
+    }
+
+private:
+    ComputerBase::Port m_input;
+    ComputerBase::Port m_output;
+};
+
+// For programs that only compute in memory: Input and Output are invalid,
+// and a machine has no ports at all.
+class NoIO
+{
+public:
+    static constexpr bool kEnabled = false;
+
+    void clear() {}
+};
+
+// An Intcode interpreter, specialized at compile time for a feature policy
+// and an I/O policy. Computer, with everything, is the one most code wants;
+// a narrower machine gives up what its workload does not use and does not
+// pay for it.
+template <typename Features = AllFeatures, typename IO = PortIO>
+class BasicComputer : public ComputerBase
+{
+public:
+    // The decode cache and code map have an entry per program word, so for a
+    // large program they are only paid for as they are used.
+    using DecodeCache = std::vector<Instruction, PageAllocator<Instruction>>;
+    using CodeMap = std::vector<uint8_t, PageAllocator<uint8_t>>;
+
+    // Everything needed to resume a machine. The memory image is shared
+    // copy-on-write between the snapshot and every machine forked from it.
+    struct Snapshot
+    {
+        bool started;
+        bool halted;
+        int64_t pc;
+        int64_t baseOffset;
+        uint64_t executed;
+        size_t memorySize;
+        std::shared_ptr<const MemoryImage> memory;
+        DecodeCache decoded;
+        CodeMap codeMap;
+        IO io;
+    };
+
+    BasicComputer(const std::vector<int64_t> & program, size_t memorySize = Memory::kDefaultSize)
+        : m_started(false)
+        , m_halted(false)
+        , m_pc(0)
+        , m_baseOffset(0)
+        , m_executed(0)
+        , m_memory(std::max(memorySize, program.size()))
+        , m_decoded(program.size())
+        , m_codeMap(program.size() + kMaxInstructionLength - 1)
+    {
+        m_memory.load(program);
+    }
+
+    // Parses the program straight into memory, without a vector in between.
+    explicit BasicComputer(const ProgramFile & program, size_t memorySize = Memory::kDefaultSize)
+        : m_started(false)
+        , m_halted(false)
+        , m_pc(0)
+        , m_baseOffset(0)
+        , m_executed(0)
+        , m_memory(std::max(memorySize, program.words()))
+        , m_decoded(program.words())
+        , m_codeMap(program.words() + kMaxInstructionLength - 1)
+    {
+        m_memory.extend(program.parse(m_memory.data()));
+    }
+
+    explicit BasicComputer(const Snapshot & snapshot)
+        : m_started(snapshot.started)
+        , m_halted(snapshot.halted)
+        , m_pc(snapshot.pc)
+        , m_baseOffset(snapshot.baseOffset)
+        , m_executed(snapshot.executed)
+        , m_memory(snapshot.memory, snapshot.memorySize)
+        , m_decoded(snapshot.decoded)
+        , m_codeMap(snapshot.codeMap)
+        , m_io(snapshot.io)
+    {}
+
+    ~BasicComputer() = default;
+
+    Snapshot snapshot()
+    {
+        Snapshot snapshot;
+        snapshot.started = m_started;
+        snapshot.halted = m_halted;
+        snapshot.pc = m_pc;
+        snapshot.baseOffset = m_baseOffset;
+        snapshot.executed = m_executed;
+        snapshot.memorySize = m_memory.size();
+        snapshot.memory = m_memory.snapshot();
+        snapshot.decoded = m_decoded;
+        snapshot.codeMap = m_codeMap;
+        snapshot.io = m_io;
+
+        return snapshot;
+    }
+
+    // Returns a child machine in the current state. Parent and child share
+    // all memory pages until one of them writes to a page.
+    BasicComputer fork()
+    {
+        return BasicComputer(snapshot());
+    }
+
+    bool started() const
+    {
+        return m_started;
+    }
+
+    bool halted() const
+    {
+        return m_halted;
+    }
+
+    size_t memory_size() const
+    {
+        return m_memory.size();
+    }
+
+    int64_t read(int64_t address) const
+    {
+        return m_memory.read(address);
+    }
+
+    void write(int64_t address, int64_t value)
+    {
+        m_memory.write(address, value);
+
+        // Write barrier: data stores, which are nearly all of them, only pay
+        // for the code map lookup.
+        if (static_cast<uint64_t>(address) < m_codeMap.size() && m_codeMap[address])
+        {
+            invalidate(address);
+        }
+    }
+
+    // The port functions are only there for machines with PortIO.
+    Port & input()
+    {
+        return m_io.input();
+    }
+
+    const Port & input() const
+    {
+        return m_io.input();
+    }
+
+    Port & output()
+    {
+        return m_io.output();
+    }
+
+    const Port & output() const
+    {
+        return m_io.output();
+    }
+
+    // Returns false if the input port is full.
+    bool push_input(int64_t value)
+    {
+        return m_io.input().push(value);
+    }
+
+    // Returns how many of the values fit in the input port.
+    size_t push_input(const std::vector<int64_t> & values)
+    {
+        return m_io.input().push(values.data(), values.size());
+    }
+
+    bool has_output() const
+    {
+        return !m_io.output().empty();
+    }
+
+    bool pop_output(int64_t * value)
+    {
+        return m_io.output().pop(value);
+    }
+
+    // Drains the output port into a new vector. Use pop_output() or output()
+    // where the allocation matters.
+    std::vector<int64_t> get_output()
+    {
+        auto & port = m_io.output();
+
+        std::vector<int64_t> output(port.size());
+        output.resize(port.pop(output.data(), output.size()));
+
+        return output;
+    }
+
+    const Instruction & fetch(int64_t pc)
+    {
+        if (0 <= pc && pc < static_cast<int64_t>(m_decoded.size()))
+        {
+            auto & inst = m_decoded[pc];
+            if (inst.opcode == Undecoded)
+            {
+                inst = decode_instruction(m_memory.data() + pc, m_memory.size() - pc);
+                validate(inst);
+                mark_code(pc, inst.length);
+                fuse(pc);
+            }
+
+            return inst;
+        }
+
+        if (static_cast<uint64_t>(pc) >= m_memory.size())
+        {
+            m_scratch = Instruction{};
+
+            return m_scratch;
+        }
+
+        // NOTE: Code outside the loaded program is rare enough that it is
+        // decoded on every visit rather than growing the cache.
+        m_scratch = decode_instruction(m_memory.data() + pc, m_memory.size() - pc);
+        validate(m_scratch);
+
+        return m_scratch;
+    }
+
+    // A relative parameter outside memory reads as zero, and a destination
+    // is returned as is, so the caller must check it against the memory size.
+    int64_t evaluate_parameter(int64_t value, ParameterMode mode) const
+    {
+        bool fault = false;
+
+        return load(value, mode, fault);
+    }
+
+    int64_t evaluate_output(int64_t value, ParameterMode mode) const
+    {
+        bool fault = false;
+
+        return destination(value, mode, fault);
+    }
+
+    static const char * dispatch_mode()
+    {
+#if INTCODE_COMPUTED_GOTO
+        return "computed-goto";
+#else
+        return "switch";
+#endif
+    }
+
+    uint64_t instructions_executed() const
+    {
+        return m_executed;
+    }
+
+    // Runs until the program halts or needs input.
+    State process()
+    {
+        NullProfiler profiler;
+
+        return execute<false>(0, profiler);
+    }
+
+    // Same as process(), reporting every instruction to `profiler`. Profiled
+    // runs see each instruction separately, superinstructions or not.
+    template <typename Profiler>
+    State process(Profiler & profiler)
+    {
+        return execute<false>(0, profiler);
+    }
+
+    // Runs at most `count` instructions, returning Suspended if the program
+    // is still running afterwards.
+    State step(uint64_t count = 1)
+    {
+        NullProfiler profiler;
+
+        return execute<true>(count, profiler);
+    }
+
+    // Forgets any cached decoding that depends on the word at `address`, for
+    // callers that modified memory behind the computer's back.
+    void invalidate(int64_t address)
+    {
+        auto first = std::max<int64_t>(address - (kMaxSequenceLength - 1), 0);
+        auto last = std::min<int64_t>(address + 1, m_decoded.size());
+        for (auto i = first; i < last; ++i)
+        {
+            m_decoded[i].opcode = Undecoded;
+        }
+
+        // NOTE: No cached instruction can reach this word any more, but the
+        // others covered by the ones just dropped stay marked. A stale mark
+        // only costs one extra invalidation on the next store there.
+        if (0 <= address && address < static_cast<int64_t>(m_codeMap.size()))
+        {
+            m_codeMap[address] = 0;
+        }
+    }
+
+    // Starts recording which parts of memory the program writes, so that
+    // reset() only has to undo those.
+    void track_writes()
+    {
+        m_memory.track_writes();
+    }
+
+    // Puts a machine that tracks writes back at the start of `program`, the
+    // program it was built from, with empty ports. Only the memory blocks
+    // written since tracking started or since the last reset are restored,
+    // and cached decoding survives wherever the code was left alone, so the
+    // cost follows what the last run did rather than the size of the program.
+    void reset(const std::vector<int64_t> & program)
+    {
+        // NOTE: Code that was overwritten and then run again was decoded from
+        // the new words, which the restore is about to replace.
+        for (auto block : m_memory.written_blocks())
+        {
+            auto first = block * Memory::kBlockWords;
+            auto last = std::min(first + Memory::kBlockWords, m_codeMap.size());
+            for (auto i = first; i < last; ++i)
+            {
+                if (m_codeMap[i])
+                {
+                    invalidate(i);
+                }
+            }
+        }
+
+        m_memory.restore(program.data(), program.size());
+
+        m_started = false;
+        m_halted = false;
+        m_pc = 0;
+        m_baseOffset = 0;
+        m_executed = 0;
+        m_io.clear();
+    }
+
+    void invalidate_all()
+    {
+        for (auto & inst : m_decoded)
+        {
+            inst.opcode = Undecoded;
+        }
+
+        std::fill(m_codeMap.begin(), m_codeMap.end(), 0);
+    }
+
+private:
+    // Turns an instruction that needs something this machine was built
+    // without, or that addresses a fixed word outside memory, into an invalid
+    // one, so the interpreter never has to check.
+    void validate(Instruction & inst) const
+    {
+        validate(inst, m_memory.size());
+    }
+
+    // Same, against a memory of `memorySize` words that is about to replace
+    // this machine's.
+    void validate(Instruction & inst, size_t memorySize) const
+    {
+        auto unsupported = false;
+
+        ParameterMode modes[] = { inst.param1Mode, inst.param2Mode, inst.param3Mode };
+        auto parameters = std::max(inst.length - 1, 0);
+        for (int i = 0; i < parameters; ++i)
+        {
+            // NOTE: A destination is written as a position even in
+            // immediate mode.
+            auto destination = writes_memory(inst.opcode) && i == parameters - 1;
+            auto fixed = modes[i] == ParameterMode::PositionMode || (destination && modes[i] == ParameterMode::ImmediateMode);
+            if (fixed && static_cast<uint64_t>(inst.params[i]) >= memorySize)
+            {
+                unsupported = true;
+            }
+        }
+
+        if constexpr (!Features::kRelativeMode)
+        {
+            unsupported = unsupported || (inst.opcode == RelativeBaseOffset)
+                || std::any_of(modes, modes + parameters, [](ParameterMode mode) { return mode == ParameterMode::RelativeMode; });
+        }
+
+        if constexpr (!IO::kEnabled)
+        {
+            unsupported = unsupported || inst.opcode == Input || inst.opcode == Output;
+        }
+
+        if (unsupported)
+        {
+            inst.opcode = Undecoded;
+            inst.handler = Undecoded;
+        }
+    }
+
+    // Position-mode addresses are checked when the instruction is decoded,
+    // but a relative address is only known when it is used. One outside
+    // memory sets `fault`, which the interpreter checks before the
+    // instruction has any effect. The flag is a local of the interpreter
+    // loop, so checking it costs no memory traffic.
+    int64_t load(int64_t value, ParameterMode mode, bool & fault) const
+    {
+        if constexpr (Features::kRelativeMode)
+        {
+            switch (mode)
+            {
+                case ParameterMode::PositionMode:  { return m_memory.read(value); } break;
+                case ParameterMode::ImmediateMode: { return value;                } break;
+                case ParameterMode::RelativeMode:
+                {
+                    auto address = m_baseOffset + value;
+                    if (static_cast<uint64_t>(address) >= m_memory.size())
+                    {
+                        fault = true;
+
+                        return 0;
+                    }
+
+                    return m_memory.read(address);
+                } break;
+            }
+
+            return value;
+        }
+        else
+        {
+            (void)fault;
+            return (mode == ParameterMode::ImmediateMode) ? value : m_memory.read(value);
+        }
+    }
+
+    int64_t destination(int64_t value, ParameterMode mode, bool & fault) const
+    {
+        if constexpr (Features::kRelativeMode)
+        {
+            if (mode != ParameterMode::RelativeMode)
+            {
+                return value;
+            }
+
+            auto address = m_baseOffset + value;
+            fault = fault || static_cast<uint64_t>(address) >= m_memory.size();
+
+            return address;
+        }
+        else
+        {
+            (void)mode;
+            (void)fault;
+            return value;
+        }
+    }
+
+    static bool writes_memory(uint8_t opcode)
+    {
+        return opcode == Add || opcode == Multiply || opcode == Input || opcode == LessThan || opcode == Equals;
+    }
+
+    // Records that cached code depends on the words [pc, pc + length).
+    void mark_code(int64_t pc, size_t length)
+    {
+        auto last = std::min<size_t>(pc + length, m_codeMap.size());
+        for (auto i = static_cast<size_t>(pc); i < last; ++i)
+        {
+            m_codeMap[i] = 1;
+        }
+    }
+
+    // Turns a compare whose result is immediately tested by a jump into a
+    // superinstruction. The jump must read the cell the compare writes, so
+    // the handler can branch on the value it just computed.
+    void fuse(int64_t pc)
+    {
+#if INTCODE_SUPERINSTRUCTIONS
+        auto & inst = m_decoded[pc];
+        if ((inst.opcode != LessThan && inst.opcode != Equals) || pc + 4 >= static_cast<int64_t>(m_decoded.size()))
+        {
+            return;
+        }
+
+        // NOTE: Only a jump is decoded into the cache here. Anything else is
+        // left for fetch() to decode and fuse in its own turn, so a run of
+        // compares does not recurse once per instruction.
+        auto & jump = m_decoded[pc + 4];
+        if (jump.opcode == Undecoded)
+        {
+            auto next = decode_instruction(m_memory.data() + pc + 4, m_memory.size() - pc - 4);
+            if (next.opcode != JumpIfTrue && next.opcode != JumpIfFalse)
+            {
+                return;
+            }
+
+            validate(next);
+            jump = next;
+            mark_code(pc + 4, jump.length);
+        }
+
+        if (jump.opcode != JumpIfTrue && jump.opcode != JumpIfFalse)
+        {
+            return;
+        }
+
+        // NOTE: An immediate destination is written as a position.
+        auto destination = (inst.param3Mode == ParameterMode::RelativeMode)
+            ? ParameterMode::RelativeMode
+            : ParameterMode::PositionMode;
+
+        if (jump.param1Mode != destination || jump.params[0] != inst.params[2])
+        {
+            return;
+        }
+
+        if (inst.opcode == LessThan)
+        {
+            inst.handler = (jump.opcode == JumpIfTrue) ? LessThanJumpIfTrue : LessThanJumpIfFalse;
+        }
+        else
+        {
+            inst.handler = (jump.opcode == JumpIfTrue) ? EqualsJumpIfTrue : EqualsJumpIfFalse;
+        }
+#else
+        (void)pc;
+#endif
+    }
+
+    // Runs the jump half of a superinstruction, with m_pc at the jump. If the
+    // compare's store has just overwritten the jump, its cache entry is gone
+    // and the jump is left for the normal dispatch to decode afresh.
+    void jump_after_compare(bool taken, bool & fault)
+    {
+        auto & jump = m_decoded[m_pc];
+        if (jump.opcode == Undecoded)
+        {
+            return;
+        }
+
+        ++m_executed;
+
+        auto target = taken ? load(jump.params[1], jump.param2Mode, fault) : m_pc + 3;
+        if (!fault)
+        {
+            m_pc = target;
+        }
+    }
+
+    friend class Aot;
+    friend class Checkpoint;
+    friend class Image;
+
+    template <typename, typename>
+    friend class BasicJit;
+
+    template <bool kBounded, typename Profiler>
+    State execute(uint64_t budget, Profiler & profiler)
+    {
+        // NOTE: A bounded run must stop after exactly `budget` instructions,
+        // and a profiled one must see every instruction, so neither takes
+        // the fused handlers.
+        constexpr bool kFused = !kBounded && !Profiler::kEnabled;
+
+        m_started = true;
+
+        const Instruction * inst = nullptr;
+
+        // Set when a relative address falls outside memory; see load().
+        bool fault = false;
+
+#if INTCODE_COMPUTED_GOTO
+        // Every handler ends in its own indirect jump through this table, so
+        // the branch predictor gets one history per opcode instead of one
+        // shared switch branch for all of them.
+        #define INTCODE_INVALID_10 \
+            &&op_invalid, &&op_invalid, &&op_invalid, &&op_invalid, &&op_invalid, \
+            &&op_invalid, &&op_invalid, &&op_invalid, &&op_invalid, &&op_invalid
+
+        static void * const kDispatchTable[kHandlerCount] =
+        {
+            &&op_invalid,
+            &&op_add,
+            &&op_multiply,
+            &&op_input,
+            &&op_output,
+            &&op_jump_if_true,
+            &&op_jump_if_false,
+            &&op_less_than,
+            &&op_equals,
+            &&op_relative_base_offset,
+            INTCODE_INVALID_10, INTCODE_INVALID_10, INTCODE_INVALID_10, INTCODE_INVALID_10,
+            INTCODE_INVALID_10, INTCODE_INVALID_10, INTCODE_INVALID_10, INTCODE_INVALID_10,
+            &&op_invalid, &&op_invalid, &&op_invalid, &&op_invalid, &&op_invalid,
+            &&op_invalid, &&op_invalid, &&op_invalid, &&op_invalid,
+            &&op_halt,
+            &&op_less_than_jump_if_true,
+            &&op_less_than_jump_if_false,
+            &&op_equals_jump_if_true,
+            &&op_equals_jump_if_false,
+        };
+
+        #undef INTCODE_INVALID_10
+
+        #define INTCODE_DISPATCH()                                     \
+            do                                                         \
+            {                                                          \
+                if (kBounded && budget-- == 0)                         \
+                {                                                      \
+                    return Suspended;                                  \
+                }                                                      \
+                inst = &fetch(m_pc);                                   \
+                ++m_executed;                                          \
+                profiler.count(m_pc, inst->opcode);                    \
+                goto *kDispatchTable[kFused ? inst->handler            \
+                                            : inst->opcode];           \
+            } while (0)
+
+        INTCODE_DISPATCH();
+#else
+        #define INTCODE_DISPATCH() goto dispatch
+
+    dispatch:
+        if (kBounded && budget-- == 0)
+        {
+            return Suspended;
+        }
+
+        inst = &fetch(m_pc);
+        ++m_executed;
+        profiler.count(m_pc, inst->opcode);
+
+        switch (kFused ? inst->handler : inst->opcode)
+        {
+            case Add:                { goto op_add;                   } break;
+            case Multiply:           { goto op_multiply;              } break;
+            case Input:              { goto op_input;                 } break;
+            case Output:             { goto op_output;                } break;
+            case JumpIfTrue:         { goto op_jump_if_true;          } break;
+            case JumpIfFalse:        { goto op_jump_if_false;         } break;
+            case LessThan:           { goto op_less_than;             } break;
+            case Equals:             { goto op_equals;                } break;
+            case RelativeBaseOffset: { goto op_relative_base_offset;  } break;
+            case Halt:               { goto op_halt;                  } break;
+            case LessThanJumpIfTrue:  { goto op_less_than_jump_if_true;  } break;
+            case LessThanJumpIfFalse: { goto op_less_than_jump_if_false; } break;
+            case EqualsJumpIfTrue:    { goto op_equals_jump_if_true;     } break;
+            case EqualsJumpIfFalse:   { goto op_equals_jump_if_false;    } break;
+            default:                 { goto op_invalid;               } break;
+        }
+#endif
+
+    op_add:
+        {
+            auto op1 = load(inst->params[0], inst->param1Mode, fault);
+            auto op2 = load(inst->params[1], inst->param2Mode, fault);
+            auto result = destination(inst->params[2], inst->param3Mode, fault);
+            if (fault)
+            {
+                goto op_fault;
+            }
+
+            m_pc += 4;
+            write(result, op1 + op2);
+        }
+        INTCODE_DISPATCH();
+
+    op_multiply:
+        {
+            auto op1 = load(inst->params[0], inst->param1Mode, fault);
+            auto op2 = load(inst->params[1], inst->param2Mode, fault);
+            auto result = destination(inst->params[2], inst->param3Mode, fault);
+            if (fault)
+            {
+                goto op_fault;
+            }
+
+            m_pc += 4;
+            write(result, op1 * op2);
+        }
+        INTCODE_DISPATCH();
+
+    // NOTE: Handlers for what a machine was built without are never reached,
+    // since validate() turns their instructions into invalid ones, so their
+    // bodies are left out.
+    op_input:
+        if constexpr (IO::kEnabled)
+        {
+            // Opcode 3 takes a single integer as input and saves it to the position
+            // given by its only parameter. For example, the instruction 3,50 would
+            // take an input value and store it at address 50.
+            auto adr = destination(inst->params[0], inst->param1Mode, fault);
+            if (fault)
+            {
+                goto op_fault;
+            }
+
+            int64_t value = 0;
+            if (!m_io.input().pop(&value))
+            {
+                // NOTE: The instruction is re-executed on the next call.
+                --m_executed;
+                profiler.retry(m_pc, inst->opcode);
+
+                return WaitingForInput;
+            }
+
+            m_pc += 2;
+            write(adr, value);
+        }
+        INTCODE_DISPATCH();
+
+    op_output:
+        if constexpr (IO::kEnabled)
+        {
+            // Opcode 4 outputs the value of its only parameter. For example,
+            // the instruction 4,50 would output the value at address 50.
+            auto value = load(inst->params[0], inst->param1Mode, fault);
+            if (fault)
+            {
+                goto op_fault;
+            }
+
+            if (!m_io.output().push(value))
+            {
+                --m_executed;
+                profiler.retry(m_pc, inst->opcode);
+
+                return WaitingForOutput;
+            }
+
+            m_pc += 2;
+        }
+        INTCODE_DISPATCH();
+
+    op_jump_if_true:
+        {
+            auto op1 = load(inst->params[0], inst->param1Mode, fault);
+            auto op2 = load(inst->params[1], inst->param2Mode, fault);
+
+            if (fault)
+            {
+                goto op_fault;
+            }
+
+            profiler.branch(m_pc, op1 != 0);
+            m_pc = (op1 != 0) ? op2 : m_pc + 3;
+        }
+        INTCODE_DISPATCH();
+
+    op_jump_if_false:
+        {
+            auto op1 = load(inst->params[0], inst->param1Mode, fault);
+            auto op2 = load(inst->params[1], inst->param2Mode, fault);
+
+            if (fault)
+            {
+                goto op_fault;
+            }
+
+            profiler.branch(m_pc, op1 == 0);
+            m_pc = (op1 == 0) ? op2 : m_pc + 3;
+        }
+        INTCODE_DISPATCH();
+
+    op_less_than:
+        {
+            auto op1 = load(inst->params[0], inst->param1Mode, fault);
+            auto op2 = load(inst->params[1], inst->param2Mode, fault);
+            auto result = destination(inst->params[2], inst->param3Mode, fault);
+            if (fault)
+            {
+                goto op_fault;
+            }
+
+            m_pc += 4;
+            write(result, (op1 < op2) ? 1 : 0);
+        }
+        INTCODE_DISPATCH();
+
+    op_equals:
+        {
+            auto op1 = load(inst->params[0], inst->param1Mode, fault);
+            auto op2 = load(inst->params[1], inst->param2Mode, fault);
+            auto result = destination(inst->params[2], inst->param3Mode, fault);
+            if (fault)
+            {
+                goto op_fault;
+            }
+
+            m_pc += 4;
+            write(result, (op1 == op2) ? 1 : 0);
+        }
+        INTCODE_DISPATCH();
+
+    op_relative_base_offset:
+        if constexpr (Features::kRelativeMode)
+        {
+            auto offset = load(inst->params[0], inst->param1Mode, fault);
+            if (fault)
+            {
+                goto op_fault;
+            }
+
+            m_baseOffset += offset;
+
+            m_pc += 2;
+        }
+        INTCODE_DISPATCH();
+
+    op_less_than_jump_if_true:
+    op_less_than_jump_if_false:
+    op_equals_jump_if_true:
+    op_equals_jump_if_false:
+        {
+            auto op1 = load(inst->params[0], inst->param1Mode, fault);
+            auto op2 = load(inst->params[1], inst->param2Mode, fault);
+            auto result = destination(inst->params[2], inst->param3Mode, fault);
+            if (fault)
+            {
+                goto op_fault;
+            }
+
+            auto handler = inst->handler;
+            auto value = (handler == LessThanJumpIfTrue || handler == LessThanJumpIfFalse) ? (op1 < op2) : (op1 == op2);
+
+            m_pc += 4;
+            write(result, value ? 1 : 0);
+
+            jump_after_compare((handler == LessThanJumpIfTrue || handler == EqualsJumpIfTrue) ? value : !value, fault);
+            if (fault)
+            {
+                goto op_fault;
+            }
+        }
+        INTCODE_DISPATCH();
+
+    op_halt:
+        {
+            m_halted = true;
+
+            return Halted;
+        }
+
+    op_invalid:
+        {
+            m_halted = true;
+
+            return InvalidInstruction;
+        }
+
+    op_fault:
+        {
+            // NOTE: The instruction stays at the pc, as an invalid one does.
+            m_halted = true;
+
+            return InvalidInstruction;
+        }
+
+        #undef INTCODE_DISPATCH
+    }
+
+    bool m_started;
+    bool m_halted;
+
+    int64_t m_pc;
+    int64_t m_baseOffset;
+    uint64_t m_executed;
+    Memory m_memory;
+    DecodeCache m_decoded;
+
+    // One byte per program word, set while any cached decoding (or code the
+    // JIT compiled) may depend on it. A byte rather than a bit, so compiled
+    // stores can test it with a single compare. It runs a few words past the
+    // program, since the last instructions may read parameters from there.
+    CodeMap m_codeMap;
+
+    Instruction m_scratch;
+
+    IO m_io;
+};
+
+using Computer = BasicComputer<>;
+
+#endif
@@ -0,0 +1,50 @@
+#ifndef INTCODE_CONSOLE_H
+#define INTCODE_CONSOLE_H
+
+#include <iostream>
+
+#include "computer.h"
+
+// Runs the computer against std::cin/std::cout, prompting whenever the
+// program asks for input. `process` runs the machine until it blocks, so the
+// same loop drives the interpreter, the JIT or an ahead-of-time translation.
+template <typename Vm, typename Process>
+Computer::State run_interactive(Vm & computer, Process process)
+{
+    for (; ; )
+    {
+        auto state = process();
+
+        for (int64_t value; computer.pop_output(&value); )
+        {
+            std::cout << value << std::endl;
+        }
+
+        if (state == Computer::WaitingForOutput)
+        {
+            continue;
+        }
+
+        if (state != Computer::WaitingForInput)
+        {
+            return state;
+        }
+
+        int64_t value = 0;
+        std::cout << "Enter input:";
+        if (!(std::cin >> value))
+        {
+            return state;
+        }
+
+        computer.push_input(value);
+    }
+}
+
+template <typename Vm>
+Computer::State run_interactive(Vm & computer)
+{
+    return run_interactive(computer, [&computer]() { return computer.process(); });
+}
+
+#endif
@@ -0,0 +1,209 @@
+#ifndef INTCODE_COROUTINE_H
+#define INTCODE_COROUTINE_H
+
+#include <coroutine>
+#include <cstdint>
+#include <utility>
+
+#include "computer.h"
+
+// Runs a computer as a C++20 coroutine on top of its interpreter. The machine
+// runs until it needs input it does not have queued, co_yields the outputs it
+// produced on the way, one at a time, and then co_awaits the input, so the
+// driver hands values back and forth without juggling ports:
+//
+//     auto machine = Machine::run(computer);
+//     for (auto event = machine.resume(); event == Machine::HasOutput; event = machine.resume(signal))
+//     {
+//         signal = machine.value();
+//     }
+//
+// An output is yielded once the machine has stopped for input or halted, not
+// as the instruction runs, so between events the registers are those of the
+// stopped machine. The computer must outlive the machine, and it must not be
+// driven by process() while the machine exists.
+class Machine
+{
+public:
+    enum Event
+    {
+        HasOutput,
+        NeedsInput,
+        Halted,
+        InvalidInstruction,
+    };
+
+    struct promise_type
+    {
+        Event event = NeedsInput;
+        int64_t value = 0;
+        int64_t input = 0;
+        bool hasInput = false;
+
+        Machine get_return_object()
+        {
+            return Machine(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+
+        std::suspend_always initial_suspend() noexcept
+        {
+            return {};
+        }
+
+        std::suspend_always final_suspend() noexcept
+        {
+            return {};
+        }
+
+        std::suspend_always yield_value(int64_t output)
+        {
+            event = HasOutput;
+            value = output;
+
+            return {};
+        }
+
+        void return_value(Event result)
+        {
+            event = result;
+        }
+
+        void unhandled_exception()
+        {
+            throw;
+        }
+    };
+
+    // Awaited by the program for input the computer does not have queued.
+    // It only suspends if the driver has not already supplied a value.
+    struct InputAwaiter
+    {
+        promise_type * promise = nullptr;
+
+        bool await_ready() const
+        {
+            return false;
+        }
+
+        bool await_suspend(std::coroutine_handle<promise_type> handle)
+        {
+            promise = &handle.promise();
+            if (promise->hasInput)
+            {
+                return false;
+            }
+
+            promise->event = NeedsInput;
+
+            return true;
+        }
+
+        int64_t await_resume()
+        {
+            promise->hasInput = false;
+
+            return promise->input;
+        }
+    };
+
+    Machine(Machine && other)
+        : m_handle(std::exchange(other.m_handle, nullptr))
+    {}
+
+    Machine & operator=(Machine other)
+    {
+        std::swap(m_handle, other.m_handle);
+
+        return *this;
+    }
+
+    ~Machine()
+    {
+        if (m_handle)
+        {
+            m_handle.destroy();
+        }
+    }
+
+    // Works with any machine that has ports.
+    template <typename Features, typename IO>
+    static Machine run(BasicComputer<Features, IO> & computer);
+
+    bool done() const
+    {
+        return m_handle.done();
+    }
+
+    // Runs until the next output, until input is needed or until the program
+    // stops. A finished machine keeps reporting how it stopped.
+    Event resume()
+    {
+        if (!m_handle.done())
+        {
+            m_handle.resume();
+        }
+
+        return m_handle.promise().event;
+    }
+
+    // Hands the program one input value, then resumes. The value is held
+    // until the program asks for input; only one may be pending at a time.
+    Event resume(int64_t input)
+    {
+        auto & promise = m_handle.promise();
+        promise.input = input;
+        promise.hasInput = true;
+
+        return resume();
+    }
+
+    // The last output.
+    int64_t value() const
+    {
+        return m_handle.promise().value;
+    }
+
+private:
+    explicit Machine(std::coroutine_handle<promise_type> handle)
+        : m_handle(handle)
+    {}
+
+    std::coroutine_handle<promise_type> m_handle;
+};
+
+template <typename Features, typename IO>
+Machine Machine::run(BasicComputer<Features, IO> & computer)
+{
+    static_assert(IO::kEnabled, "A machine without I/O has nothing to suspend on");
+
+    for (; ; )
+    {
+        auto state = computer.process();
+
+        for (int64_t value; computer.pop_output(&value); )
+        {
+            co_yield value;
+        }
+
+        switch (state)
+        {
+            case Computer::WaitingForOutput:
+            {
+            } break;
+            case Computer::WaitingForInput:
+            {
+                computer.push_input(co_await InputAwaiter{});
+            } break;
+            case Computer::Halted:
+            {
+                co_return Halted;
+            } break;
+            default:
+            {
+                co_return InvalidInstruction;
+            } break;
+        }
+    }
+}
+
+#endif
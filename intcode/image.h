@@ -0,0 +1,430 @@
+#ifndef INTCODE_IMAGE_H
+#define INTCODE_IMAGE_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#if !defined(_WIN32)
+    #include <fcntl.h>
+    #include <unistd.h>
+#endif
+
+#include "computer.h"
+#include "instruction.h"
+#include "memory.h"
+#include "program.h"
+
+// A program stored ready to run:
+//
+//     header | memory image | decoded instructions | code map
+//
+// The memory image is the program's words as little-endian int64. The
+// optional decoded instructions and code map are the interpreter's decode
+// cache after decoding everything reachable from address 0, so a machine
+// loaded from the image starts with a warm cache. Every section starts on a
+// 64 KiB boundary, a multiple of any common page size, so the sections are
+// mapped straight from the file, copy-on-write, rather than read in.
+//
+// The decode cache is only used when the loading build lays out Instruction
+// the same way as the build that wrote it; otherwise it starts out empty.
+// Either way the file is checked against the checksums in the header before
+// anything from it is used.
+class Image
+{
+public:
+    static constexpr uint32_t kVersion = 1;
+    static constexpr uint64_t kAlignment = 64 * 1024;
+
+    enum Flags : uint32_t
+    {
+        // The image carries a decode cache.
+        Decoded = 1 << 0,
+        // Its handlers include superinstructions.
+        Fused = 1 << 1,
+    };
+
+    // Writes `program` as an image, with the decode cache unless `decoded`
+    // is false. Like a checkpoint, the file is written under a temporary name
+    // and renamed into place.
+    static bool save(const std::vector<int64_t> & program, const char * filename, bool decoded = true)
+    {
+        Header header{};
+        std::memcpy(header.magic, kMagic, sizeof(header.magic));
+        header.version = kVersion;
+        header.byteOrder = kByteOrder;
+        header.words = program.size();
+        header.instructionSize = sizeof(Instruction);
+        header.checksum = program_checksum(program.data(), program.size());
+        header.cacheChecksum = kChecksumSeed;
+
+        header.memoryOffset = align(sizeof(Header));
+        auto end = header.memoryOffset + align(program.size() * sizeof(int64_t));
+
+        Computer computer(program);
+        if (decoded)
+        {
+            discover(computer);
+
+            header.flags = Decoded | (INTCODE_SUPERINSTRUCTIONS ? static_cast<uint32_t>(Fused) : 0u);
+            header.decodedOffset = end;
+            header.codeMapOffset = header.decodedOffset + align(computer.m_decoded.size() * sizeof(Instruction));
+            header.codeMapBytes = computer.m_codeMap.size();
+            end = header.codeMapOffset + align(header.codeMapBytes);
+
+            header.cacheChecksum = checksum(header.cacheChecksum, computer.m_decoded.data(), computer.m_decoded.size() * sizeof(Instruction));
+            header.cacheChecksum = checksum(header.cacheChecksum, computer.m_codeMap.data(), computer.m_codeMap.size());
+        }
+
+        auto temporary = std::string(filename) + ".tmp";
+        {
+            std::ofstream fs(temporary, std::ofstream::binary | std::ofstream::trunc);
+
+            fs.write(reinterpret_cast<const char *>(&header), sizeof(header));
+            pad(fs, header.memoryOffset);
+            fs.write(reinterpret_cast<const char *>(program.data()), program.size() * sizeof(int64_t));
+
+            if (decoded)
+            {
+                pad(fs, header.decodedOffset);
+                fs.write(reinterpret_cast<const char *>(computer.m_decoded.data()), computer.m_decoded.size() * sizeof(Instruction));
+                pad(fs, header.codeMapOffset);
+                fs.write(reinterpret_cast<const char *>(computer.m_codeMap.data()), computer.m_codeMap.size());
+            }
+
+            // NOTE: The memory image is mapped a page at a time, so the file
+            // must hold every page of it in full.
+            pad(fs, end);
+
+            if (!fs.flush())
+            {
+                std::remove(temporary.c_str());
+
+                return false;
+            }
+        }
+
+#if defined(_WIN32)
+        std::remove(filename);
+#endif
+
+        return std::rename(temporary.c_str(), filename) == 0;
+    }
+
+    // Replaces the machine's state with the program in the image, ready to
+    // run from address 0. Memory and the decode cache are mapped from the
+    // file rather than read, so nothing is parsed or decoded; loading costs
+    // one pass over each mapped section, which checks the section and, for
+    // the decode cache, fits it to this machine on the way. Returns false, leaving
+    // the machine untouched, if the file is missing, is not an image or does
+    // not match its checksums.
+    //
+    // A machine with fewer features than the one that wrote the image gets
+    // the same cache, less whatever it cannot run, which is turned into
+    // invalid instructions as it is loaded.
+    template <typename Features, typename IO>
+    static bool load(BasicComputer<Features, IO> * computer, const char * filename, size_t memorySize = Memory::kDefaultSize)
+    {
+        using Vm = BasicComputer<Features, IO>;
+
+        std::ifstream fs(filename, std::ifstream::binary);
+
+        Header header{};
+        if (!read_header(fs, &header) || !fits(fs, header.memoryOffset, header.words, sizeof(int64_t)))
+        {
+            return false;
+        }
+
+        auto cached = (header.flags & Decoded) && header.instructionSize == sizeof(Instruction)
+            && header.codeMapBytes == header.words + kMaxInstructionLength - 1;
+        if (cached && !(fits(fs, header.decodedOffset, header.words, sizeof(Instruction)) && fits(fs, header.codeMapOffset, header.codeMapBytes, 1)))
+        {
+            return false;
+        }
+
+        auto fd = open_file(filename);
+
+        Memory memory(std::max<size_t>(memorySize, header.words));
+        typename Vm::DecodeCache decoded(header.words);
+        typename Vm::CodeMap codeMap(header.words + kMaxInstructionLength - 1);
+
+        auto loaded = load_section(fs, fd, memory.data(), header.words * sizeof(int64_t), header.memoryOffset)
+            && program_checksum(memory.data(), header.words) == header.checksum;
+        if (loaded && cached)
+        {
+            loaded = load_section(fs, fd, decoded.data(), decoded.size() * sizeof(Instruction), header.decodedOffset)
+                && load_section(fs, fd, codeMap.data(), codeMap.size(), header.codeMapOffset);
+
+            // NOTE: Each instruction is hashed as it was saved before it is
+            // changed, and nothing reaches the machine unless the whole cache
+            // matches its checksum. The image was decoded against the
+            // writer's memory size, which may be bigger than this machine's.
+            auto hash = kChecksumSeed;
+            for (size_t i = 0; loaded && i < decoded.size(); ++i)
+            {
+                auto & inst = decoded[i];
+                hash = checksum(hash, &inst, sizeof(Instruction));
+                if (!well_formed(inst))
+                {
+                    loaded = false;
+                    break;
+                }
+
+                if (!INTCODE_SUPERINSTRUCTIONS && (header.flags & Fused))
+                {
+                    inst.handler = inst.opcode;
+                }
+
+                if (inst.opcode != Undecoded)
+                {
+                    computer->validate(inst, memory.size());
+                }
+            }
+
+            loaded = loaded && checksum(hash, codeMap.data(), codeMap.size()) == header.cacheChecksum;
+        }
+
+        close_file(fd);
+
+        if (!loaded)
+        {
+            return false;
+        }
+
+        memory.extend(header.words);
+
+        computer->m_started = false;
+        computer->m_halted = false;
+        computer->m_pc = 0;
+        computer->m_baseOffset = 0;
+        computer->m_executed = 0;
+        computer->m_memory = std::move(memory);
+        computer->m_decoded = std::move(decoded);
+        computer->m_codeMap = std::move(codeMap);
+        computer->m_io.clear();
+
+        return true;
+    }
+
+    // Checks every section of the image against the checksums in the
+    // header, whether or not this build could use its decode cache.
+    static bool verify(const char * filename)
+    {
+        std::ifstream fs(filename, std::ifstream::binary);
+
+        Header header{};
+        if (!read_header(fs, &header) || !fits(fs, header.memoryOffset, header.words, sizeof(int64_t)))
+        {
+            return false;
+        }
+
+        std::vector<int64_t> words(header.words);
+        fs.seekg(header.memoryOffset);
+        fs.read(reinterpret_cast<char *>(words.data()), words.size() * sizeof(int64_t));
+
+        if (!fs || program_checksum(words.data(), words.size()) != header.checksum)
+        {
+            return false;
+        }
+
+        auto cacheChecksum = kChecksumSeed;
+        if (header.flags & Decoded)
+        {
+            if (!fits(fs, header.decodedOffset, header.words, header.instructionSize) || !fits(fs, header.codeMapOffset, header.codeMapBytes, 1))
+            {
+                return false;
+            }
+
+            std::vector<char> bytes(header.words * header.instructionSize);
+            fs.seekg(header.decodedOffset);
+            fs.read(bytes.data(), bytes.size());
+            cacheChecksum = checksum(cacheChecksum, bytes.data(), bytes.size());
+
+            bytes.resize(header.codeMapBytes);
+            fs.seekg(header.codeMapOffset);
+            fs.read(bytes.data(), bytes.size());
+            cacheChecksum = checksum(cacheChecksum, bytes.data(), bytes.size());
+        }
+
+        return fs && cacheChecksum == header.cacheChecksum;
+    }
+
+private:
+    static constexpr char kMagic[8] = { 'I', 'N', 'T', 'C', 'I', 'M', 'G', '\0' };
+
+    // Reads back as this value only on a host with the writer's byte order.
+    static constexpr uint32_t kByteOrder = 0x01020304;
+
+    static constexpr uint64_t kChecksumSeed = 14695981039346656037ull;
+
+    struct Header
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t flags;
+        uint32_t byteOrder;
+        uint32_t instructionSize;
+        uint64_t words;
+        uint64_t checksum;
+        // Covers the decode cache and the code map, as written.
+        uint64_t cacheChecksum;
+        uint64_t memoryOffset;
+        uint64_t decodedOffset;
+        uint64_t codeMapOffset;
+        uint64_t codeMapBytes;
+    };
+
+    static uint64_t align(uint64_t offset)
+    {
+        return ((offset + kAlignment - 1) / kAlignment) * kAlignment;
+    }
+
+    static void pad(std::ofstream & fs, uint64_t offset)
+    {
+        static const char zeros[4096] = {};
+        for (auto at = static_cast<uint64_t>(fs.tellp()); fs && at < offset; at = static_cast<uint64_t>(fs.tellp()))
+        {
+            fs.write(zeros, std::min<uint64_t>(offset - at, sizeof(zeros)));
+        }
+    }
+
+    // FNV-1a, continuing from `hash`.
+    static uint64_t checksum(uint64_t hash, const void * data, size_t bytes)
+    {
+        auto p = static_cast<const uint8_t *>(data);
+        for (size_t i = 0; i < bytes; ++i)
+        {
+            hash ^= p[i];
+            hash *= 1099511628211ull;
+        }
+
+        return hash;
+    }
+
+    // Whether the file holds `count` items of `size` bytes at `offset`,
+    // padded out to the alignment as save() writes them. Sections that are
+    // mapped must not run past the end of the file, or touching them faults.
+    static bool fits(std::ifstream & fs, uint64_t offset, uint64_t count, uint64_t size)
+    {
+        fs.seekg(0, std::ifstream::end);
+        auto fileSize = static_cast<uint64_t>(fs.tellg());
+        fs.seekg(0);
+
+        return fs && offset % kAlignment == 0 && offset <= fileSize
+            && size != 0 && count <= (fileSize - offset) / size
+            && align(count * size) <= fileSize - offset;
+    }
+
+    // Whether a cached instruction read from a file is one the interpreter
+    // can dispatch on; anything else would index past its handler table.
+    static bool well_formed(const Instruction & inst)
+    {
+        if (inst.opcode == Undecoded)
+        {
+            return true;
+        }
+
+        auto mode = [](ParameterMode m) { return m <= ParameterMode::RelativeMode; };
+        auto fused = (inst.opcode == LessThan || inst.opcode == Equals) && inst.handler >= LessThanJumpIfTrue;
+
+        return inst.opcode <= Halt && (inst.handler == inst.opcode || (fused && inst.handler < kHandlerCount))
+            && inst.length == instruction_length(inst.opcode)
+            && mode(inst.param1Mode) && mode(inst.param2Mode) && mode(inst.param3Mode);
+    }
+
+    static bool read_header(std::ifstream & fs, Header * header)
+    {
+        return fs.read(reinterpret_cast<char *>(header), sizeof(*header))
+            && std::memcmp(header->magic, kMagic, sizeof(header->magic)) == 0
+            && header->version == kVersion
+            && header->byteOrder == kByteOrder;
+    }
+
+    // Decodes everything reachable from address 0 by falling through and by
+    // following jumps to immediate targets. Other targets are only known at
+    // run time, and are decoded then.
+    static void discover(Computer & computer)
+    {
+        auto size = static_cast<int64_t>(computer.m_decoded.size());
+
+        // NOTE: Fusing a compare decodes the jump after it as well, so the
+        // cache itself cannot tell which addresses have been followed.
+        std::vector<bool> visited(size, false);
+        std::vector<int64_t> work{ 0 };
+        while (!work.empty())
+        {
+            auto pc = work.back();
+            work.pop_back();
+
+            if (pc < 0 || pc >= size || visited[pc])
+            {
+                continue;
+            }
+
+            visited[pc] = true;
+
+            auto & inst = computer.fetch(pc);
+            if (inst.opcode == Undecoded || inst.opcode == Halt)
+            {
+                continue;
+            }
+
+            if ((inst.opcode == JumpIfTrue || inst.opcode == JumpIfFalse) && inst.param2Mode == ParameterMode::ImmediateMode)
+            {
+                work.push_back(inst.params[1]);
+            }
+
+            work.push_back(pc + inst.length);
+        }
+    }
+
+    static int open_file(const char * filename)
+    {
+#if defined(_WIN32)
+        (void)filename;
+        return -1;
+#else
+        return open(filename, O_RDONLY);
+#endif
+    }
+
+    static void close_file(int fd)
+    {
+#if !defined(_WIN32)
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+#endif
+    }
+
+    // Fills `data` with `bytes` of the file at `offset`. Anything of a page
+    // or more is mapped over the destination, which must then be whole pages
+    // at a page boundary, as Memory and PageAllocator hand out. Smaller
+    // sections, and any on a host whose pages are bigger than the alignment,
+    // are read in.
+    static bool load_section(std::ifstream & fs, int fd, void * data, size_t bytes, uint64_t offset)
+    {
+#if !defined(_WIN32)
+        auto page = Memory::page_size();
+        if (fd >= 0 && bytes >= page && offset % page == 0)
+        {
+            return map_file_pages(data, PageAllocator<uint8_t>::round_up(bytes), fd, offset);
+        }
+#else
+        (void)fd;
+#endif
+
+        fs.seekg(offset);
+        fs.read(static_cast<char *>(data), bytes);
+
+        return static_cast<bool>(fs);
+    }
+};
+
+#endif
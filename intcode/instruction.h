@@ -0,0 +1,127 @@
+#ifndef INTCODE_INSTRUCTION_H
+#define INTCODE_INSTRUCTION_H
+
+#include <cstdint>
+
+enum OpCode : uint8_t
+{
+    // NOTE: Zero is never a valid opcode, so it doubles as the
+    // "not decoded yet" marker in the instruction cache.
+    Undecoded = 0,
+
+    Add = 1,
+    Multiply = 2,
+    Input = 3,
+    Output = 4,
+    JumpIfTrue = 5,
+    JumpIfFalse = 6,
+    LessThan = 7,
+    Equals = 8,
+    RelativeBaseOffset = 9,
+
+    Halt = 99,
+};
+
+// Handlers past the opcodes, for pairs of instructions the interpreter runs
+// as one. Only the instruction cache ever holds these.
+enum Superinstruction : uint8_t
+{
+    LessThanJumpIfTrue = 100,
+    LessThanJumpIfFalse,
+    EqualsJumpIfTrue,
+    EqualsJumpIfFalse,
+
+    kHandlerCount,
+};
+
+enum class ParameterMode : uint8_t
+{
+    PositionMode,
+    ImmediateMode,
+    RelativeMode,
+};
+
+// A fully decoded instruction. The parameter words are copied out of memory
+// at decode time, so executing a cached instruction never touches the
+// instruction stream again until one of its words is overwritten.
+struct Instruction
+{
+    uint8_t opcode;
+    uint8_t length;
+    // The interpreter handler: the opcode, or a superinstruction that also
+    // runs the instruction after this one.
+    uint8_t handler;
+    ParameterMode param1Mode;
+    ParameterMode param2Mode;
+    ParameterMode param3Mode;
+    int64_t params[3];
+};
+
+inline uint8_t instruction_length(uint8_t opcode)
+{
+    switch (opcode)
+    {
+        case Add:                { return 4; } break;
+        case Multiply:           { return 4; } break;
+        case Input:              { return 2; } break;
+        case Output:             { return 2; } break;
+        case JumpIfTrue:         { return 3; } break;
+        case JumpIfFalse:        { return 3; } break;
+        case LessThan:           { return 4; } break;
+        case Equals:             { return 4; } break;
+        case RelativeBaseOffset: { return 2; } break;
+    }
+
+    return 1;
+}
+
+// The longest instruction is four words, so a write to address a can only
+// affect instructions starting in [a - 3, a].
+constexpr int64_t kMaxInstructionLength = 4;
+
+// A superinstruction covers a compare and the jump after it, so a write to
+// address a can affect cached handlers starting in [a - 6, a].
+constexpr int64_t kMaxSequenceLength = 7;
+
+inline Instruction decode_instruction(const int64_t * code, int64_t available)
+{
+    // NOTE: Negative words leave a negative remainder, which must not be
+    // mistaken for a valid opcode (or index past a dispatch table).
+    auto opcode = code[0] % 100;
+
+    Instruction instruction;
+    instruction.opcode = (opcode < 0) ? static_cast<uint8_t>(Undecoded) : static_cast<uint8_t>(opcode);
+    instruction.length = instruction_length(instruction.opcode);
+
+    // NOTE: A mode digit that names no mode makes the instruction invalid,
+    // rather than reaching a handler as an out of range ParameterMode. Digits
+    // for parameters the instruction does not have are ignored.
+    int64_t digits[3] = { (code[0] / 100) % 10, (code[0] / 1'000) % 10, (code[0] / 10'000) % 10 };
+    ParameterMode modes[3] = {};
+    for (int64_t i = 0; i < 3; ++i)
+    {
+        if (0 <= digits[i] && digits[i] <= static_cast<int64_t>(ParameterMode::RelativeMode))
+        {
+            modes[i] = static_cast<ParameterMode>(digits[i]);
+        }
+        else if (i + 1 < instruction.length)
+        {
+            instruction.opcode = Undecoded;
+            instruction.length = instruction_length(Undecoded);
+        }
+    }
+
+    instruction.param1Mode = modes[0];
+    instruction.param2Mode = modes[1];
+    instruction.param3Mode = modes[2];
+    instruction.handler = instruction.opcode;
+
+    for (int64_t i = 0; i < 3; ++i)
+    {
+        instruction.params[i] = (i + 1 < instruction.length && i + 1 < available) ? code[i + 1] : 0;
+    }
+
+    return instruction;
+}
+
+#endif
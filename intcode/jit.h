@@ -0,0 +1,639 @@
+#ifndef INTCODE_JIT_H
+#define INTCODE_JIT_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <vector>
+
+#include "computer.h"
+
+#if defined(__x86_64__) && (defined(__unix__) || defined(__APPLE__))
+    #define INTCODE_JIT 1
+    #include <sys/mman.h>
+    #include <unistd.h>
+#else
+    #define INTCODE_JIT 0
+#endif
+
+#if INTCODE_JIT
+
+// Translates straight-line runs of Intcode into x86-64 machine code. A block
+// starts at a jump target (or wherever the interpreter left off) and runs
+// until a jump, an instruction it cannot compile, or kMaxBlockLength
+// instructions. Input, Output and Halt are never compiled; the computer's
+// interpreter executes them one at a time, so I/O behaves exactly as it does
+// without the JIT.
+//
+// Every word covered by a compiled block, or decoded by the interpreter, is
+// flagged in a code map. Compiled stores check the map and leave the block as
+// soon as they hit code, and the dispatcher then throws away every block and
+// cached decoding that covers the written word. A Jit is bound to a single
+// computer; once attached, drive that computer only through the Jit.
+//
+// Compiled code runs with the System V calling convention:
+//     rdi = memory base, rsi = JitState *
+//     r8  = relative base, r9 = memory size in words, r10 = code map
+//
+// Like the interpreter, the JIT is specialized on the machine's feature and
+// I/O policies, and leaves whatever the machine lacks to the interpreter to
+// reject.
+template <typename Features = AllFeatures, typename IO = PortIO>
+class BasicJit
+{
+public:
+    using Vm = BasicComputer<Features, IO>;
+
+    static constexpr size_t kMaxBlockLength = 64;
+    static constexpr size_t kArenaSize = 4 * 1024 * 1024;
+
+    explicit BasicJit(Vm & computer)
+        : m_computer(computer)
+        , m_compiled(0)
+        , m_staticExtent(0)
+        , m_arena(nullptr)
+        , m_used(0)
+        , m_blocks(computer.m_decoded.size())
+        , m_uncompilable(computer.m_decoded.size(), false)
+        , m_codeMap(computer.m_codeMap)
+    {
+        m_arena = static_cast<uint8_t *>(mmap(nullptr, kArenaSize, PROT_READ | PROT_WRITE,
+                                              MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+        if (m_arena == MAP_FAILED)
+        {
+            throw std::bad_alloc();
+        }
+    }
+
+    BasicJit(const BasicJit &) = delete;
+    BasicJit & operator=(const BasicJit &) = delete;
+
+    ~BasicJit()
+    {
+        munmap(m_arena, kArenaSize);
+    }
+
+    size_t blocks_compiled() const
+    {
+        return m_compiled;
+    }
+
+    // Same contract as Computer::process(), but hot code runs natively.
+    Computer::State process()
+    {
+        auto & computer = m_computer;
+        computer.m_started = true;
+
+        JitState state;
+        state.codeMap = m_codeMap.data();
+        state.size = static_cast<int64_t>(computer.m_memory.size());
+        load_state(&state);
+
+        for (; ; )
+        {
+            auto pc = computer.m_pc;
+
+            Block * block = nullptr;
+            if (0 <= pc && pc < static_cast<int64_t>(m_blocks.size()))
+            {
+                block = m_blocks[pc].get();
+                if (!block && !m_uncompilable[pc])
+                {
+                    block = compile(pc);
+                }
+            }
+
+            if (block)
+            {
+                auto executed = state.executed;
+                computer.m_pc = block->entry(computer.m_memory.data(), &state);
+
+                if (state.reason == CodeWrite)
+                {
+                    state.reason = Continue;
+                    invalidate(state.address);
+                }
+
+                // A block that bails out on its first instruction (say, on a
+                // relative address outside memory) would be entered again
+                // forever, so that instruction is left to the interpreter.
+                if (computer.m_pc != pc || state.executed != executed)
+                {
+                    continue;
+                }
+            }
+
+            // Everything else goes through the interpreter, one instruction
+            // at a time, with the registers handed back and forth.
+            store_state(&state);
+
+            auto & inst = computer.fetch(pc);
+            auto written = writes_memory(inst.opcode)
+                ? computer.evaluate_output(inst.params[inst.length - 2], mode(inst, inst.length - 2))
+                : -1;
+
+            // NOTE: Checked before the step, whose write barrier clears the
+            // mark once the interpreter's own entries are gone.
+            auto writesCode = 0 <= written && written < static_cast<int64_t>(m_codeMap.size()) && m_codeMap[written];
+
+            auto result = computer.step(1);
+            if (result != Computer::Suspended)
+            {
+                return result;
+            }
+
+            if (writesCode)
+            {
+                invalidate(written);
+            }
+
+            load_state(&state);
+        }
+    }
+
+private:
+    enum ExitReason : int64_t
+    {
+        Continue = 0,
+        CodeWrite = 1,
+    };
+
+    // Shared with the generated code; the offsets are baked into the
+    // instructions emitted below.
+    struct JitState
+    {
+        int64_t base;       // 0
+        int64_t size;       // 8
+        uint8_t * codeMap;  // 16
+        int64_t reason;     // 24
+        int64_t address;    // 32
+        uint64_t executed;  // 40
+        int64_t extent;     // 48
+    };
+
+    using BlockFunction = int64_t (*)(int64_t * memory, JitState * state);
+
+    struct Block
+    {
+        BlockFunction entry;
+        int64_t start;
+        int64_t end;
+    };
+
+    void load_state(JitState * state) const
+    {
+        state->base = m_computer.m_baseOffset;
+        state->reason = Continue;
+        state->address = 0;
+        state->executed = 0;
+        state->extent = static_cast<int64_t>(m_computer.m_memory.extent());
+    }
+
+    void store_state(const JitState * state)
+    {
+        m_computer.m_baseOffset = state->base;
+        m_computer.m_executed += state->executed;
+        m_computer.m_memory.extend(std::max<size_t>(state->extent, m_staticExtent));
+    }
+
+    static bool writes_memory(uint8_t opcode)
+    {
+        return opcode == Add || opcode == Multiply || opcode == Input || opcode == LessThan || opcode == Equals;
+    }
+
+    static ParameterMode mode(const Instruction & inst, int index)
+    {
+        switch (index)
+        {
+            case 0: { return inst.param1Mode; } break;
+            case 1: { return inst.param2Mode; } break;
+        }
+
+        return inst.param3Mode;
+    }
+
+    void invalidate(int64_t address)
+    {
+        auto first = std::max<int64_t>(address - static_cast<int64_t>(kMaxBlockLength * kMaxInstructionLength), 0);
+        for (auto pc = first; pc <= address; ++pc)
+        {
+            auto & block = m_blocks[pc];
+            if (block && block->end > address)
+            {
+                block.reset();
+            }
+
+            m_uncompilable[pc] = false;
+        }
+
+        // NOTE: The code map is shared with the interpreter, so only the
+        // written word is unmarked, by the computer. The rest of a discarded
+        // block stays marked until a store there finds nothing to drop.
+        m_computer.invalidate(address);
+    }
+
+    // Blocks are keyed by their start address, and only code inside the
+    // loaded program is compiled.
+    Block * compile(int64_t start)
+    {
+        m_code.clear();
+
+        auto memory = m_computer.m_memory.data();
+        auto size = static_cast<int64_t>(m_computer.m_memory.size());
+        auto limit = static_cast<int64_t>(m_blocks.size());
+
+        // Prologue: load the relative base, memory size and code map.
+        emit({ 0x4C, 0x8B, 0x46, 0x00 });   // mov r8, [rsi + 0]
+        emit({ 0x4C, 0x8B, 0x4E, 0x08 });   // mov r9, [rsi + 8]
+        emit({ 0x4C, 0x8B, 0x56, 0x10 });   // mov r10, [rsi + 16]
+
+        size_t count = 0;
+        size_t staticExtent = 0;
+        int64_t pc = start;
+        bool terminated = false;
+
+        while (count < kMaxBlockLength && pc < limit)
+        {
+            auto inst = decode_instruction(memory + pc, limit - pc);
+            if (pc + inst.length > limit || !compilable(inst, size))
+            {
+                break;
+            }
+
+            switch (inst.opcode)
+            {
+                case Add:
+                case Multiply:
+                case LessThan:
+                case Equals:
+                {
+                    emit_load(0x00, inst.params[0], inst.param1Mode, pc, count);   // rax
+                    emit_load(0x08, inst.params[1], inst.param2Mode, pc, count);   // rcx
+
+                    switch (inst.opcode)
+                    {
+                        case Add:      { emit({ 0x48, 0x01, 0xC8 });       } break;   // add rax, rcx
+                        case Multiply: { emit({ 0x48, 0x0F, 0xAF, 0xC1 }); } break;   // imul rax, rcx
+                        case LessThan:
+                        case Equals:
+                        {
+                            emit({ 0x48, 0x39, 0xC8 });                                // cmp rax, rcx
+                            emit({ 0x0F, static_cast<uint8_t>((inst.opcode == LessThan) ? 0x9C : 0x94), 0xC0 });   // setl/sete al
+                            emit({ 0x0F, 0xB6, 0xC0 });                                // movzx eax, al
+                        } break;
+                    }
+
+                    if (inst.param3Mode == ParameterMode::PositionMode)
+                    {
+                        staticExtent = std::max<size_t>(staticExtent, inst.params[2] + 1);
+                    }
+
+                    emit_store(inst.params[2], inst.param3Mode, pc, pc + 4, count);
+                } break;
+                case JumpIfTrue:
+                case JumpIfFalse:
+                {
+                    emit_load(0x00, inst.params[0], inst.param1Mode, pc, count);   // rax
+                    emit_load(0x08, inst.params[1], inst.param2Mode, pc, count);   // rcx
+
+                    emit({ 0x48, 0x85, 0xC0 });                                    // test rax, rax
+                    emit({ 0x0F, static_cast<uint8_t>((inst.opcode == JumpIfTrue) ? 0x84 : 0x85) });   // je/jne not_taken
+                    auto notTaken = emit_rel32();
+
+                    emit({ 0x48, 0x89, 0xC8 });                                    // mov rax, rcx
+                    emit_exit_to_rax(count + 1, Continue);
+
+                    patch_rel32(notTaken);
+                    emit_exit(pc + 3, count + 1, Continue);
+
+                    terminated = true;
+                } break;
+                case RelativeBaseOffset:
+                {
+                    emit_load(0x00, inst.params[0], inst.param1Mode, pc, count);   // rax
+                    emit({ 0x49, 0x01, 0xC0 });                                    // add r8, rax
+                } break;
+            }
+
+            pc += inst.length;
+            count += 1;
+
+            if (terminated)
+            {
+                break;
+            }
+        }
+
+        if (count == 0)
+        {
+            m_uncompilable[start] = true;
+
+            return nullptr;
+        }
+
+        if (!terminated)
+        {
+            emit_exit(pc, count, Continue);
+        }
+
+        auto code = install();
+        if (!code)
+        {
+            return nullptr;
+        }
+
+        auto block = std::make_unique<Block>();
+        block->entry = reinterpret_cast<BlockFunction>(code);
+        block->start = start;
+        block->end = pc;
+
+        m_staticExtent = std::max(m_staticExtent, staticExtent);
+
+        std::memset(&m_codeMap[start], 1, pc - start);
+
+        m_blocks[start] = std::move(block);
+        ++m_compiled;
+
+        return m_blocks[start].get();
+    }
+
+    // Only arithmetic, comparisons, jumps and relative base changes are
+    // compiled, and only when every absolute address is in range and fits a
+    // 32-bit displacement.
+    static bool compilable(const Instruction & inst, int64_t size)
+    {
+        if constexpr (!Features::kRelativeMode)
+        {
+            if (inst.opcode == RelativeBaseOffset)
+            {
+                return false;
+            }
+
+            for (int i = 0; i + 1 < inst.length; ++i)
+            {
+                if (mode(inst, i) == ParameterMode::RelativeMode)
+                {
+                    return false;
+                }
+            }
+        }
+
+        auto absolute_ok = [size](int64_t value, ParameterMode mode)
+        {
+            switch (mode)
+            {
+                case ParameterMode::PositionMode:  { return 0 <= value && value < size && value <= INT32_MAX / 8; } break;
+                case ParameterMode::ImmediateMode: { return true; } break;
+                case ParameterMode::RelativeMode:  { return INT32_MIN <= value && value <= INT32_MAX; } break;
+            }
+
+            return false;
+        };
+
+        switch (inst.opcode)
+        {
+            case Add:
+            case Multiply:
+            case LessThan:
+            case Equals:
+            {
+                return absolute_ok(inst.params[0], inst.param1Mode)
+                    && absolute_ok(inst.params[1], inst.param2Mode)
+                    && inst.param3Mode != ParameterMode::ImmediateMode
+                    && absolute_ok(inst.params[2], inst.param3Mode);
+            } break;
+            case JumpIfTrue:
+            case JumpIfFalse:
+            {
+                return absolute_ok(inst.params[0], inst.param1Mode)
+                    && absolute_ok(inst.params[1], inst.param2Mode);
+            } break;
+            case RelativeBaseOffset:
+            {
+                return absolute_ok(inst.params[0], inst.param1Mode);
+            } break;
+        }
+
+        return false;
+    }
+
+    void emit(std::initializer_list<uint8_t> bytes)
+    {
+        m_code.insert(m_code.end(), bytes.begin(), bytes.end());
+    }
+
+    void emit_u8(uint8_t value)
+    {
+        m_code.push_back(value);
+    }
+
+    void emit_u32(uint32_t value)
+    {
+        for (int i = 0; i < 4; ++i)
+        {
+            m_code.push_back(static_cast<uint8_t>(value >> (i * 8)));
+        }
+    }
+
+    void emit_u64(uint64_t value)
+    {
+        for (int i = 0; i < 8; ++i)
+        {
+            m_code.push_back(static_cast<uint8_t>(value >> (i * 8)));
+        }
+    }
+
+    size_t emit_rel32()
+    {
+        auto offset = m_code.size();
+        emit_u32(0);
+
+        return offset;
+    }
+
+    void patch_rel32(size_t offset)
+    {
+        auto rel = static_cast<uint32_t>(m_code.size() - (offset + 4));
+        for (int i = 0; i < 4; ++i)
+        {
+            m_code[offset + i] = static_cast<uint8_t>(rel >> (i * 8));
+        }
+    }
+
+    // Leaves the block: saves the relative base, accounts for the executed
+    // instructions and returns the next pc (already in rax for the second
+    // form).
+    void emit_exit_to_rax(size_t count, ExitReason reason)
+    {
+        emit({ 0x4C, 0x89, 0x46, 0x00 });                  // mov [rsi + 0], r8
+        emit({ 0x48, 0x81, 0x46, 0x28 });                  // add qword [rsi + 40], imm32
+        emit_u32(static_cast<uint32_t>(count));
+        emit({ 0x48, 0xC7, 0x46, 0x18 });                  // mov qword [rsi + 24], imm32
+        emit_u32(static_cast<uint32_t>(reason));
+        emit_u8(0xC3);                                     // ret
+    }
+
+    void emit_exit(int64_t pc, size_t count, ExitReason reason)
+    {
+        emit({ 0x48, 0xB8 });                              // mov rax, imm64
+        emit_u64(static_cast<uint64_t>(pc));
+        emit_exit_to_rax(count, reason);
+    }
+
+    // Computes a relative address into rdx, bailing out to the interpreter
+    // (at the current instruction) if it is outside memory.
+    void emit_relative_address(int64_t value, int64_t pc, size_t count)
+    {
+        emit({ 0x49, 0x8D, 0x90 });                        // lea rdx, [r8 + disp32]
+        emit_u32(static_cast<uint32_t>(value));
+        emit({ 0x4C, 0x39, 0xCA });                        // cmp rdx, r9
+        emit({ 0x0F, 0x82 });                              // jb in_range
+        auto inRange = emit_rel32();
+        emit_exit(pc, count, Continue);
+        patch_rel32(inRange);
+    }
+
+    // Loads a parameter into rax (reg = 0x00) or rcx (reg = 0x08).
+    void emit_load(uint8_t reg, int64_t value, ParameterMode mode, int64_t pc, size_t count)
+    {
+        switch (mode)
+        {
+            case ParameterMode::PositionMode:
+            {
+                emit({ 0x48, 0x8B, static_cast<uint8_t>(0x87 | reg) });   // mov reg, [rdi + disp32]
+                emit_u32(static_cast<uint32_t>(value * 8));
+            } break;
+            case ParameterMode::ImmediateMode:
+            {
+                emit({ 0x48, static_cast<uint8_t>(0xB8 | (reg >> 3)) });   // mov reg, imm64
+                emit_u64(static_cast<uint64_t>(value));
+            } break;
+            case ParameterMode::RelativeMode:
+            {
+                emit_relative_address(value, pc, count);
+                emit({ 0x48, 0x8B, static_cast<uint8_t>(0x04 | reg), 0xD7 });   // mov reg, [rdi + rdx * 8]
+            } break;
+        }
+    }
+
+    // Stores rax, then leaves the block if the word was compiled code.
+    void emit_store(int64_t value, ParameterMode mode, int64_t pc, int64_t next, size_t count)
+    {
+        if (mode == ParameterMode::RelativeMode)
+        {
+            emit_relative_address(value, pc, count);
+
+            // Relative stores can land anywhere, so keep the extent current.
+            emit({ 0x48, 0x3B, 0x56, 0x30 });              // cmp rdx, [rsi + 48]
+            emit({ 0x72, 0x08 });                          // jb +8
+            emit({ 0x48, 0x8D, 0x4A, 0x01 });              // lea rcx, [rdx + 1]
+            emit({ 0x48, 0x89, 0x4E, 0x30 });              // mov [rsi + 48], rcx
+        }
+        else
+        {
+            emit({ 0x48, 0xBA });                          // mov rdx, imm64
+            emit_u64(static_cast<uint64_t>(value));
+        }
+
+        emit({ 0x48, 0x89, 0x04, 0xD7 });                  // mov [rdi + rdx * 8], rax
+
+        // NOTE: Addresses past the loaded program are never compiled, so
+        // they cannot be code.
+        emit({ 0x48, 0x81, 0xFA });                        // cmp rdx, imm32
+        emit_u32(static_cast<uint32_t>(m_codeMap.size()));
+        emit({ 0x0F, 0x83 });                              // jae not_code
+        auto notCode1 = emit_rel32();
+        emit({ 0x41, 0x80, 0x3C, 0x12, 0x00 });            // cmp byte [r10 + rdx], 0
+        emit({ 0x0F, 0x84 });                              // je not_code
+        auto notCode2 = emit_rel32();
+
+        emit({ 0x48, 0x89, 0x56, 0x20 });                  // mov [rsi + 32], rdx
+        emit_exit(next, count + 1, CodeWrite);
+
+        patch_rel32(notCode1);
+        patch_rel32(notCode2);
+    }
+
+    // Copies the assembled block into the executable arena. When the arena is
+    // full every block is dropped and compilation starts over.
+    uint8_t * install()
+    {
+        if (m_used + m_code.size() > kArenaSize)
+        {
+            for (auto & block : m_blocks)
+            {
+                block.reset();
+            }
+
+            m_used = 0;
+
+            if (m_code.size() > kArenaSize)
+            {
+                return nullptr;
+            }
+        }
+
+        auto page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        auto first = (m_used / page) * page;
+        auto last = ((m_used + m_code.size() + page - 1) / page) * page;
+
+        mprotect(m_arena + first, last - first, PROT_READ | PROT_WRITE);
+        std::memcpy(m_arena + m_used, m_code.data(), m_code.size());
+        mprotect(m_arena + first, last - first, PROT_READ | PROT_EXEC);
+
+        auto code = m_arena + m_used;
+        m_used += (m_code.size() + 15) & ~size_t(15);
+
+        return code;
+    }
+
+    Vm & m_computer;
+    size_t m_compiled;
+    size_t m_staticExtent;
+
+    uint8_t * m_arena;
+    size_t m_used;
+
+    std::vector<std::unique_ptr<Block>> m_blocks;
+    std::vector<bool> m_uncompilable;
+    typename Vm::CodeMap & m_codeMap;
+
+    std::vector<uint8_t> m_code;
+};
+
+#else
+
+// Without an x86-64 System V target the JIT is a thin wrapper around the
+// interpreter, so callers do not need their own fallback.
+template <typename Features = AllFeatures, typename IO = PortIO>
+class BasicJit
+{
+public:
+    using Vm = BasicComputer<Features, IO>;
+
+    explicit BasicJit(Vm & computer)
+        : m_computer(computer)
+    {}
+
+    size_t blocks_compiled() const
+    {
+        return 0;
+    }
+
+    Computer::State process()
+    {
+        return m_computer.process();
+    }
+
+private:
+    Vm & m_computer;
+};
+
+#endif
+
+using Jit = BasicJit<>;
+
+#endif
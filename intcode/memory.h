@@ -0,0 +1,525 @@
+#ifndef INTCODE_MEMORY_H
+#define INTCODE_MEMORY_H
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+#if defined(_WIN32)
+    #define WIN32_LEAN_AND_MEAN
+    #define NOMINMAX
+    #include <windows.h>
+#else
+    #include <sys/mman.h>
+    #include <unistd.h>
+#endif
+
+#if !defined(_WIN32)
+// Maps `bytes` of the file at `offset` over the pages at `address`,
+// copy-on-write. The address and the offset must both be page-aligned.
+inline bool map_file_pages(void * address, size_t bytes, int fd, uint64_t offset)
+{
+    auto mapped = mmap(address, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, static_cast<off_t>(offset));
+
+    return mapped != MAP_FAILED;
+}
+#endif
+
+// An immutable copy of the touched part of a Memory. On POSIX systems the
+// pages live in an anonymous file, and every Memory created from the image
+// maps that file privately: clean pages are shared between all of them and
+// the kernel copies a page only when one of the mappings first writes to it.
+class MemoryImage
+{
+public:
+    MemoryImage(const int64_t * words, size_t extent, size_t bytes)
+        : m_extent(extent)
+        , m_bytes(bytes)
+#if defined(_WIN32)
+        , m_words(words, words + extent)
+#else
+        , m_fd(-1)
+#endif
+    {
+#if !defined(_WIN32)
+    #if defined(__linux__)
+        m_fd = memfd_create("intcode-image", 0);
+    #else
+        char name[] = "/tmp/intcode-image-XXXXXX";
+        m_fd = mkstemp(name);
+        if (m_fd >= 0)
+        {
+            unlink(name);
+        }
+    #endif
+        if (m_fd < 0 || ftruncate(m_fd, m_bytes) != 0)
+        {
+            throw std::bad_alloc();
+        }
+
+        auto data = reinterpret_cast<const char *>(words);
+        auto remaining = extent * sizeof(int64_t);
+        for (size_t offset = 0; remaining > 0; )
+        {
+            auto written = pwrite(m_fd, data + offset, remaining, offset);
+            if (written <= 0)
+            {
+                throw std::bad_alloc();
+            }
+
+            offset += written;
+            remaining -= written;
+        }
+#endif
+    }
+
+    MemoryImage(const MemoryImage &) = delete;
+    MemoryImage & operator=(const MemoryImage &) = delete;
+
+    ~MemoryImage()
+    {
+#if !defined(_WIN32)
+        close(m_fd);
+#endif
+    }
+
+    size_t extent() const
+    {
+        return m_extent;
+    }
+
+    size_t bytes() const
+    {
+        return m_bytes;
+    }
+
+private:
+    friend class Memory;
+
+    size_t m_extent;
+    size_t m_bytes;
+#if defined(_WIN32)
+    std::vector<int64_t> m_words;
+#else
+    int m_fd;
+#endif
+};
+
+// Intcode memory backed by a large reserved virtual range. Nothing is
+// committed up front: the kernel hands out zero pages on first touch, so a
+// machine only pays for the pages its program actually uses.
+//
+// read() and write() only assert that the address is in range. The
+// interpreter checks every address against size() itself and stops with
+// InvalidInstruction instead. The range is also surrounded by inaccessible
+// guard pages, which catch code that indexes data() slightly out of range,
+// but only within kGuardSize of either end.
+class Memory
+{
+public:
+    static constexpr size_t kDefaultSize = size_t(1) << 24;
+    static constexpr size_t kGuardSize = 64 * 1024;
+
+    // The unit of write tracking: 4 KiB, a page on most hosts.
+    static constexpr size_t kBlockWords = 512;
+
+    explicit Memory(size_t words = kDefaultSize)
+        : m_base(nullptr)
+        , m_words(0)
+        , m_extent(0)
+        , m_reservation(0)
+    {
+        reserve(words);
+    }
+
+    // Creates a copy-on-write view of the image.
+    Memory(const std::shared_ptr<const MemoryImage> & image, size_t words = kDefaultSize)
+        : Memory(std::max(words, image->extent()))
+    {
+        map(*image);
+    }
+
+    Memory(const Memory & rhs)
+        : Memory(rhs.m_words)
+    {
+        std::memcpy(m_base, rhs.m_base, rhs.m_extent * sizeof(int64_t));
+        m_extent = rhs.m_extent;
+    }
+
+    Memory(Memory && rhs) noexcept
+        : m_base(rhs.m_base)
+        , m_words(rhs.m_words)
+        , m_extent(rhs.m_extent)
+        , m_reservation(rhs.m_reservation)
+        , m_written(std::move(rhs.m_written))
+        , m_writtenBlocks(std::move(rhs.m_writtenBlocks))
+    {
+        rhs.m_base = nullptr;
+        rhs.m_words = 0;
+        rhs.m_extent = 0;
+        rhs.m_reservation = 0;
+    }
+
+    Memory & operator=(Memory rhs) noexcept
+    {
+        std::swap(m_base, rhs.m_base);
+        std::swap(m_words, rhs.m_words);
+        std::swap(m_extent, rhs.m_extent);
+        std::swap(m_reservation, rhs.m_reservation);
+        std::swap(m_written, rhs.m_written);
+        std::swap(m_writtenBlocks, rhs.m_writtenBlocks);
+
+        return *this;
+    }
+
+    ~Memory()
+    {
+        release();
+    }
+
+    size_t size() const
+    {
+        return m_words;
+    }
+
+    // One past the highest address that has ever been written.
+    size_t extent() const
+    {
+        return m_extent;
+    }
+
+    int64_t * data()
+    {
+        return m_base;
+    }
+
+    const int64_t * data() const
+    {
+        return m_base;
+    }
+
+    int64_t read(int64_t address) const
+    {
+        assert(0 <= address && static_cast<size_t>(address) < m_words);
+
+        return m_base[address];
+    }
+
+    void write(int64_t address, int64_t value)
+    {
+        assert(0 <= address && static_cast<size_t>(address) < m_words);
+
+        m_base[address] = value;
+
+        if (static_cast<size_t>(address) >= m_extent)
+        {
+            m_extent = address + 1;
+        }
+
+        // NOTE: Untracked memory has no blocks, so this costs one compare.
+        auto block = static_cast<size_t>(address) / kBlockWords;
+        if (block < m_written.size() && !m_written[block])
+        {
+            m_written[block] = 1;
+            m_writtenBlocks.push_back(block);
+        }
+    }
+
+    // Starts recording which blocks write() stores to, so that restore() can
+    // undo a run by copying back only those. Writes made through data() are
+    // not recorded. A copy of the memory does not track writes.
+    void track_writes()
+    {
+        m_written.assign((m_words + kBlockWords - 1) / kBlockWords, 0);
+        m_writtenBlocks.clear();
+    }
+
+    bool tracks_writes() const
+    {
+        return !m_written.empty();
+    }
+
+    // The blocks written since tracking started or since the last restore(),
+    // in the order they were first written.
+    const std::vector<size_t> & written_blocks() const
+    {
+        return m_writtenBlocks;
+    }
+
+    // Puts every written block back the way `image` has it, with zeros past
+    // its end, and forgets the writes. The image must be what memory held
+    // when tracking started. The cost depends on how much was written, not on
+    // the size of the image.
+    void restore(const int64_t * image, size_t words)
+    {
+        assert(tracks_writes() && words <= m_words);
+
+        for (auto block : m_writtenBlocks)
+        {
+            auto first = block * kBlockWords;
+            auto last = std::min(first + kBlockWords, m_words);
+            auto copied = std::clamp(words, first, last);
+
+            std::copy(image + first, image + copied, m_base + first);
+            std::fill(m_base + copied, m_base + last, 0);
+
+            m_written[block] = 0;
+        }
+
+        m_writtenBlocks.clear();
+        m_extent = words;
+    }
+
+    // Records writes made directly through data().
+    void extend(size_t extent)
+    {
+        m_extent = std::max(m_extent, std::min(extent, m_words));
+    }
+
+    void load(const std::vector<int64_t> & program)
+    {
+        assert(program.size() <= m_words);
+
+        std::copy(program.begin(), program.end(), m_base);
+        m_extent = std::max(m_extent, program.size());
+    }
+
+    // Freezes the touched part of memory into an image that new Memory
+    // objects can share. This memory is remapped onto the image as well, so
+    // afterwards it only owns the pages it writes to.
+    std::shared_ptr<const MemoryImage> snapshot()
+    {
+        auto page = page_size();
+        auto bytes = ((m_extent * sizeof(int64_t) + page - 1) / page) * page;
+
+        auto image = std::make_shared<const MemoryImage>(m_base, m_extent, bytes);
+        map(*image);
+
+        return image;
+    }
+
+    // Whether the page holds anything other than zeros. Pages that were
+    // never written are always zero.
+    bool page_touched(size_t page) const
+    {
+        auto words = page_size() / sizeof(int64_t);
+        auto first = m_base + page * words;
+
+        return std::any_of(first, first + words, [](int64_t word) { return word != 0; });
+    }
+
+#if !defined(_WIN32)
+    // Maps `count` pages of the file at `offset` over the pages starting at
+    // `page`, copy-on-write. The offset must be a multiple of the page size.
+    bool map_file(int fd, uint64_t offset, size_t page, size_t count)
+    {
+        auto bytes = page_size();
+        assert((page + count) * bytes <= m_words * sizeof(int64_t));
+
+        return map_file_pages(reinterpret_cast<char *>(m_base) + page * bytes, count * bytes, fd, offset);
+    }
+#endif
+
+    static size_t page_size()
+    {
+#if defined(_WIN32)
+        SYSTEM_INFO info;
+        GetSystemInfo(&info);
+        return info.dwPageSize;
+#else
+        return static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#endif
+    }
+
+private:
+    void reserve(size_t words)
+    {
+        auto page = page_size();
+        auto bytes = ((words * sizeof(int64_t) + page - 1) / page) * page;
+
+        m_reservation = kGuardSize + bytes + kGuardSize;
+
+#if defined(_WIN32)
+        auto region = static_cast<char *>(VirtualAlloc(nullptr, m_reservation, MEM_RESERVE, PAGE_NOACCESS));
+        if (!region || !VirtualAlloc(region + kGuardSize, bytes, MEM_COMMIT, PAGE_READWRITE))
+        {
+            throw std::bad_alloc();
+        }
+#else
+        auto region = static_cast<char *>(mmap(nullptr, m_reservation, PROT_NONE,
+                                               MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0));
+        if (region == MAP_FAILED)
+        {
+            throw std::bad_alloc();
+        }
+
+        if (mprotect(region + kGuardSize, bytes, PROT_READ | PROT_WRITE) != 0)
+        {
+            munmap(region, m_reservation);
+            throw std::bad_alloc();
+        }
+#endif
+
+        m_base = reinterpret_cast<int64_t *>(region + kGuardSize);
+        m_words = bytes / sizeof(int64_t);
+    }
+
+    void map(const MemoryImage & image)
+    {
+        if (image.bytes() == 0)
+        {
+            return;
+        }
+
+#if defined(_WIN32)
+        std::copy(image.m_words.begin(), image.m_words.end(), m_base);
+#else
+        auto mapped = mmap(m_base, image.bytes(), PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_FIXED, image.m_fd, 0);
+        if (mapped == MAP_FAILED)
+        {
+            throw std::bad_alloc();
+        }
+#endif
+
+        m_extent = image.extent();
+    }
+
+    void release()
+    {
+        if (!m_base)
+        {
+            return;
+        }
+
+        auto region = reinterpret_cast<char *>(m_base) - kGuardSize;
+
+#if defined(_WIN32)
+        VirtualFree(region, 0, MEM_RELEASE);
+#else
+        munmap(region, m_reservation);
+#endif
+
+        m_base = nullptr;
+    }
+
+    int64_t * m_base;
+    size_t m_words;
+    size_t m_extent;
+    size_t m_reservation;
+
+    // A byte per block while tracking writes, and the blocks marked so far.
+    std::vector<uint8_t> m_written;
+    std::vector<size_t> m_writtenBlocks;
+};
+
+// An allocator for large arrays that cost nothing until they are touched.
+// Blocks of a page or more come straight from the kernel as zero pages, and
+// elements created without a value are left as that zeroed memory instead of
+// being value-initialized one by one. Only suitable for types whose value-
+// initialized state is all zero bytes.
+//
+// NOTE: Capacity a vector reuses after shrinking is not zeroed again, so
+// arrays using this allocator are only ever created at their final size, or
+// grown with an explicit value.
+template <typename T>
+class PageAllocator
+{
+public:
+    using value_type = T;
+
+    PageAllocator() = default;
+
+    template <typename U>
+    PageAllocator(const PageAllocator<U> &)
+    {}
+
+    T * allocate(size_t count)
+    {
+        auto bytes = count * sizeof(T);
+        if (small(bytes))
+        {
+            auto block = std::calloc(count, sizeof(T));
+            if (!block)
+            {
+                throw std::bad_alloc();
+            }
+
+            return static_cast<T *>(block);
+        }
+
+#if defined(_WIN32)
+        auto block = VirtualAlloc(nullptr, bytes, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+        if (!block)
+        {
+            throw std::bad_alloc();
+        }
+#else
+        auto block = mmap(nullptr, round_up(bytes), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (block == MAP_FAILED)
+        {
+            throw std::bad_alloc();
+        }
+#endif
+
+        return static_cast<T *>(block);
+    }
+
+    void deallocate(T * block, size_t count)
+    {
+        auto bytes = count * sizeof(T);
+        if (small(bytes))
+        {
+            std::free(block);
+
+            return;
+        }
+
+#if defined(_WIN32)
+        VirtualFree(block, 0, MEM_RELEASE);
+#else
+        munmap(block, round_up(bytes));
+#endif
+    }
+
+    template <typename U>
+    void construct(U * element)
+    {
+        ::new (static_cast<void *>(element)) U;
+    }
+
+    template <typename U, typename... Args>
+    void construct(U * element, Args &&... args)
+    {
+        ::new (static_cast<void *>(element)) U(std::forward<Args>(args)...);
+    }
+
+    // Blocks below a page come from calloc(), unless the type needs more
+    // alignment than calloc() promises.
+    static bool small(size_t bytes)
+    {
+        return bytes < Memory::page_size() && alignof(T) <= alignof(std::max_align_t);
+    }
+
+    // Blocks of a page or more are whole pages, mapped at a page boundary.
+    static size_t round_up(size_t bytes)
+    {
+        auto page = Memory::page_size();
+
+        return ((bytes + page - 1) / page) * page;
+    }
+
+    friend bool operator==(const PageAllocator &, const PageAllocator &)
+    {
+        return true;
+    }
+};
+
+#endif
@@ -0,0 +1,243 @@
+#ifndef INTCODE_PIPELINE_H
+#define INTCODE_PIPELINE_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "computer.h"
+
+// Runs a ring of computers concurrently, one thread per machine. Each
+// machine's output is forwarded into the next machine's input port, and the
+// last machine feeds the first. A stage that is blocked on input or on a full
+// downstream port spins briefly and then parks until a neighbour wakes it.
+//
+// The stage threads are started once and park between runs, so a pipeline
+// that is run many times over (after resetting its machines) does not pay for
+// creating threads every time.
+//
+// Once every machine has stopped, whatever the last machine produced after the
+// first one stopped is left in the first machine's input port.
+template <typename Vm = Computer>
+class BasicPipeline
+{
+public:
+    explicit BasicPipeline(const std::vector<Vm *> & machines)
+        : m_stages(machines.size())
+        , m_generation(0)
+        , m_running(0)
+        , m_stopping(false)
+    {
+        m_threads.reserve(machines.size());
+        for (size_t i = 0; i < machines.size(); ++i)
+        {
+            m_stages[i].computer = machines[i];
+            m_threads.emplace_back([this, i]() { serve(i); });
+        }
+    }
+
+    BasicPipeline(const BasicPipeline &) = delete;
+    BasicPipeline & operator=(const BasicPipeline &) = delete;
+
+    ~BasicPipeline()
+    {
+        m_stopping.store(true, std::memory_order_relaxed);
+        m_generation.fetch_add(1, std::memory_order_release);
+        m_generation.notify_all();
+
+        for (auto & thread : m_threads)
+        {
+            thread.join();
+        }
+    }
+
+    // Whether this pipeline runs exactly these machines, in this order.
+    bool runs(const std::vector<Vm *> & machines) const
+    {
+        return std::equal(m_stages.begin(), m_stages.end(), machines.begin(), machines.end(),
+                          [](const Stage & stage, Vm * computer) { return stage.computer == computer; });
+    }
+
+    // Runs until every machine has stopped and returns the first state other
+    // than Halted, if any. Not to be called from more than one thread at a
+    // time.
+    Computer::State run()
+    {
+        for (auto & stage : m_stages)
+        {
+            stage.done.store(false, std::memory_order_relaxed);
+        }
+
+        m_running.store(m_stages.size(), std::memory_order_relaxed);
+        m_generation.fetch_add(1, std::memory_order_release);
+        m_generation.notify_all();
+
+        for (auto running = m_running.load(std::memory_order_acquire); running != 0; running = m_running.load(std::memory_order_acquire))
+        {
+            m_running.wait(running, std::memory_order_acquire);
+        }
+
+        for (auto & stage : m_stages)
+        {
+            if (stage.state != Computer::Halted)
+            {
+                return stage.state;
+            }
+        }
+
+        return Computer::Halted;
+    }
+
+private:
+    struct alignas(64) Stage
+    {
+        Vm * computer = nullptr;
+        Computer::State state = Computer::Halted;
+        std::atomic<bool> done{ false };
+
+        // Bumped whenever something this stage may be waiting for changes.
+        std::atomic<uint32_t> signal{ 0 };
+    };
+
+    static constexpr int kSpinCount = 1024;
+
+    Stage & next(size_t i)
+    {
+        return m_stages[(i + 1) % m_stages.size()];
+    }
+
+    Stage & previous(size_t i)
+    {
+        return m_stages[(i + m_stages.size() - 1) % m_stages.size()];
+    }
+
+    static void wake(Stage & stage)
+    {
+        stage.signal.fetch_add(1, std::memory_order_release);
+        stage.signal.notify_one();
+    }
+
+    // Waits until `ready()` holds: spins first, since the neighbour is usually
+    // about to deliver, and then parks on the stage's signal.
+    template <typename Ready>
+    static void wait(Stage & stage, Ready ready)
+    {
+        for (int i = 0; i < kSpinCount; ++i)
+        {
+            if (ready())
+            {
+                return;
+            }
+
+            std::this_thread::yield();
+        }
+
+        for (; ; )
+        {
+            auto seen = stage.signal.load(std::memory_order_acquire);
+            if (ready())
+            {
+                return;
+            }
+
+            stage.signal.wait(seen, std::memory_order_acquire);
+        }
+    }
+
+    // The body of stage `i`'s thread: one run_stage() per run(), until the
+    // pipeline is destroyed.
+    void serve(size_t i)
+    {
+        for (uint32_t seen = 0; ; )
+        {
+            m_generation.wait(seen, std::memory_order_acquire);
+            seen = m_generation.load(std::memory_order_acquire);
+
+            if (m_stopping.load(std::memory_order_relaxed))
+            {
+                return;
+            }
+
+            run_stage(i);
+
+            if (m_running.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            {
+                m_running.notify_one();
+            }
+        }
+    }
+
+    void run_stage(size_t i)
+    {
+        auto & stage = m_stages[i];
+        auto & upstream = previous(i);
+        auto & downstream = next(i);
+        auto & computer = *stage.computer;
+        auto & output = computer.output();
+        auto & target = downstream.computer->input();
+
+        for (; ; )
+        {
+            auto state = computer.process();
+
+            // Whatever was consumed may unblock the stage feeding this one.
+            wake(upstream);
+
+            int64_t values[64];
+            for (size_t count; (count = output.pop(values, 64)) > 0; )
+            {
+                for (size_t sent = 0; ; )
+                {
+                    sent += target.push(values + sent, count - sent);
+                    wake(downstream);
+
+                    if (sent == count || downstream.done.load(std::memory_order_acquire))
+                    {
+                        break;
+                    }
+
+                    wait(stage, [&]() { return !target.full() || downstream.done.load(std::memory_order_acquire); });
+                }
+            }
+
+            if (state == Computer::WaitingForInput)
+            {
+                auto & input = computer.input();
+                wait(stage, [&]() { return !input.empty() || upstream.done.load(std::memory_order_acquire); });
+
+                if (input.empty())
+                {
+                    // NOTE: The machine upstream stopped without sending
+                    // anything more, so this one can never continue.
+                    stage.state = state;
+                    break;
+                }
+            }
+            else if (state != Computer::WaitingForOutput)
+            {
+                stage.state = state;
+                break;
+            }
+        }
+
+        stage.done.store(true, std::memory_order_release);
+        wake(upstream);
+        wake(downstream);
+    }
+
+    std::vector<Stage> m_stages;
+    std::vector<std::thread> m_threads;
+
+    // Bumped to start a run, and once more to stop the threads.
+    std::atomic<uint32_t> m_generation;
+    // Stages still busy with the current run.
+    std::atomic<size_t> m_running;
+    std::atomic<bool> m_stopping;
+};
+
+using Pipeline = BasicPipeline<>;
+
+#endif
@@ -0,0 +1,90 @@
+#ifndef INTCODE_POOL_H
+#define INTCODE_POOL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "computer.h"
+#include "memory.h"
+
+// Machines that all run the same program, kept for reuse instead of being
+// rebuilt for every run. A machine is put back at the start of the program by
+// restoring only the memory blocks its last run wrote, and its decode cache
+// and ports are reused as they are, so resetting a machine after a short run
+// is cheap however big the program is.
+//
+// acquire() and release() may be called from any thread. reset() only
+// touches the machine it is given.
+//
+// NOTE: Stores made by code the JIT compiled bypass the write tracking, so
+// machines run with a Jit must not be reset.
+template <typename Vm = Computer>
+class BasicComputerPool
+{
+public:
+    explicit BasicComputerPool(const std::vector<int64_t> & program, size_t memorySize = Memory::kDefaultSize)
+        : m_program(program)
+        , m_memorySize(memorySize)
+    {}
+
+    BasicComputerPool(const BasicComputerPool &) = delete;
+    BasicComputerPool & operator=(const BasicComputerPool &) = delete;
+
+    ~BasicComputerPool() = default;
+
+    const std::vector<int64_t> & program() const
+    {
+        return m_program;
+    }
+
+    // Returns a machine at the start of the program, reusing a released one
+    // if there is any. It stays owned by the pool.
+    Vm & acquire()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        if (!m_free.empty())
+        {
+            auto computer = m_free.back();
+            m_free.pop_back();
+
+            return *computer;
+        }
+
+        m_machines.push_back(std::make_unique<Vm>(m_program, m_memorySize));
+        m_machines.back()->track_writes();
+
+        return *m_machines.back();
+    }
+
+    // Resets a machine and hands it back for the next acquire().
+    void release(Vm & computer)
+    {
+        reset(computer);
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_free.push_back(&computer);
+    }
+
+    // Puts a machine from this pool back at the start of the program without
+    // releasing it.
+    void reset(Vm & computer) const
+    {
+        computer.reset(m_program);
+    }
+
+private:
+    std::vector<int64_t> m_program;
+    size_t m_memorySize;
+
+    std::mutex m_mutex;
+    std::vector<std::unique_ptr<Vm>> m_machines;
+    std::vector<Vm *> m_free;
+};
+
+using ComputerPool = BasicComputerPool<>;
+
+#endif
@@ -0,0 +1,191 @@
+#ifndef INTCODE_PROFILER_H
+#define INTCODE_PROFILER_H
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <iomanip>
+#include <ostream>
+#include <vector>
+
+#include "computer.h"
+#include "instruction.h"
+#include "memory.h"
+
+// Counts executions per opcode and per program counter, and how often each
+// jump was taken. Pass one to Computer::process() and print report() once
+// the program has stopped. Program counters past `memorySize`, which only
+// ever hold an invalid instruction, are counted per opcode alone:
+//
+//     Profiler profiler;
+//     computer.process(profiler);
+//     profiler.report(std::cerr, computer);
+class Profiler
+{
+public:
+    static constexpr bool kEnabled = true;
+
+    explicit Profiler(size_t memorySize = Memory::kDefaultSize)
+        : m_opcodes{}
+        , m_total(0)
+        , m_memorySize(memorySize)
+    {}
+
+    ~Profiler() = default;
+
+    void count(int64_t pc, uint8_t opcode)
+    {
+        ++m_opcodes[opcode];
+        ++m_total;
+
+        if (auto site = at(pc))
+        {
+            site->opcode = opcode;
+            ++site->executed;
+        }
+    }
+
+    void retry(int64_t pc, uint8_t opcode)
+    {
+        --m_opcodes[opcode];
+        --m_total;
+
+        if (auto site = at(pc))
+        {
+            --site->executed;
+        }
+    }
+
+    void branch(int64_t pc, bool taken)
+    {
+        if (auto site = at(pc))
+        {
+            ++(taken ? site->taken : site->notTaken);
+        }
+    }
+
+    uint64_t total() const
+    {
+        return m_total;
+    }
+
+    uint64_t executed(uint8_t opcode) const
+    {
+        return m_opcodes[opcode];
+    }
+
+    // Prints the opcode mix, then the `top` busiest program counters with the
+    // words currently at each of them and, for jumps, how often they went
+    // each way.
+    template <typename Features, typename IO>
+    void report(std::ostream & out, const BasicComputer<Features, IO> & computer, size_t top = 20) const
+    {
+        out << "instructions: " << m_total << "\n\n";
+
+        out << std::left << std::setw(22) << "opcode" << std::right << std::setw(14) << "count" << std::setw(9) << "share" << "\n";
+        for (size_t opcode = 0; opcode < m_opcodes.size(); ++opcode)
+        {
+            if (m_opcodes[opcode] > 0)
+            {
+                out << std::left << std::setw(22) << name(static_cast<uint8_t>(opcode))
+                    << std::right << std::setw(14) << m_opcodes[opcode]
+                    << std::setw(8) << std::fixed << std::setprecision(2) << percent(m_opcodes[opcode], m_total) << "%\n";
+            }
+        }
+
+        std::vector<int64_t> hottest;
+        for (size_t pc = 0; pc < m_sites.size(); ++pc)
+        {
+            if (m_sites[pc].executed > 0)
+            {
+                hottest.push_back(static_cast<int64_t>(pc));
+            }
+        }
+
+        top = std::min(top, hottest.size());
+        std::partial_sort(hottest.begin(), hottest.begin() + top, hottest.end(), [this](int64_t a, int64_t b)
+        {
+            return m_sites[a].executed > m_sites[b].executed;
+        });
+
+        out << "\n" << std::setw(8) << "pc" << std::setw(14) << "count" << std::setw(9) << "share" << "  instruction\n";
+        for (size_t i = 0; i < top; ++i)
+        {
+            auto pc = hottest[i];
+            auto & site = m_sites[pc];
+
+            out << std::setw(8) << pc << std::setw(14) << site.executed
+                << std::setw(8) << std::fixed << std::setprecision(2) << percent(site.executed, m_total) << "%  "
+                << std::left << std::setw(20) << name(site.opcode) << std::right;
+
+            auto length = std::min<int64_t>(instruction_length(site.opcode), static_cast<int64_t>(computer.memory_size()) - pc);
+            for (int64_t word = 0; word < length; ++word)
+            {
+                out << " " << computer.read(pc + word);
+            }
+
+            if (site.opcode == JumpIfTrue || site.opcode == JumpIfFalse)
+            {
+                out << "  (taken " << site.taken << ", not taken " << site.notTaken << ")";
+            }
+
+            out << "\n";
+        }
+    }
+
+private:
+    struct Site
+    {
+        uint64_t executed = 0;
+        uint64_t taken = 0;
+        uint64_t notTaken = 0;
+        uint8_t opcode = Undecoded;
+    };
+
+    Site * at(int64_t pc)
+    {
+        if (pc < 0 || static_cast<uint64_t>(pc) >= m_memorySize)
+        {
+            return nullptr;
+        }
+
+        if (static_cast<size_t>(pc) >= m_sites.size())
+        {
+            m_sites.resize(pc + 1);
+        }
+
+        return &m_sites[pc];
+    }
+
+    static double percent(uint64_t count, uint64_t total)
+    {
+        return (total > 0) ? 100.0 * count / total : 0.0;
+    }
+
+    static const char * name(uint8_t opcode)
+    {
+        switch (opcode)
+        {
+            case Add:                { return "add";                  } break;
+            case Multiply:           { return "multiply";             } break;
+            case Input:              { return "input";                } break;
+            case Output:             { return "output";               } break;
+            case JumpIfTrue:         { return "jump-if-true";         } break;
+            case JumpIfFalse:        { return "jump-if-false";        } break;
+            case LessThan:           { return "less-than";            } break;
+            case Equals:             { return "equals";               } break;
+            case RelativeBaseOffset: { return "relative-base-offset"; } break;
+            case Halt:               { return "halt";                 } break;
+        }
+
+        return "invalid";
+    }
+
+    std::array<uint64_t, Halt + 1> m_opcodes;
+    uint64_t m_total;
+    size_t m_memorySize;
+    std::vector<Site> m_sites;
+};
+
+#endif
@@ -0,0 +1,213 @@
+#ifndef INTCODE_PROGRAM_H
+#define INTCODE_PROGRAM_H
+
+#include <bit>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64)
+    #include <immintrin.h>
+#endif
+
+#if !defined(_WIN32)
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+// Counts the occurrences of `c` in [begin, end), 32 or 16 bytes at a time
+// where the build allows it.
+inline size_t count_byte(const char * begin, const char * end, char c)
+{
+    size_t count = 0;
+    auto p = begin;
+
+#if defined(__AVX2__)
+    auto needle = _mm256_set1_epi8(c);
+    for (; end - p >= 32; p += 32)
+    {
+        auto block = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+        count += std::popcount(static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, needle))));
+    }
+#elif defined(__SSE2__) || defined(_M_X64)
+    auto needle = _mm_set1_epi8(c);
+    for (; end - p >= 16; p += 16)
+    {
+        auto block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        count += std::popcount(static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(block, needle))));
+    }
+#endif
+
+    for (; p != end; ++p)
+    {
+        count += (*p == c) ? 1 : 0;
+    }
+
+    return count;
+}
+
+// A comma-separated program file, mapped read-only. The number of words is
+// known as soon as the file is open, so the destination can be sized once
+// and the words parsed straight into it, without a string per word.
+class ProgramFile
+{
+public:
+    explicit ProgramFile(const char * filename)
+        : m_begin(nullptr)
+        , m_end(nullptr)
+        , m_words(0)
+    {
+#if defined(_WIN32)
+        std::ifstream fs(filename, std::ifstream::binary);
+        m_text.assign(std::istreambuf_iterator<char>(fs), std::istreambuf_iterator<char>());
+
+        m_begin = m_text.data();
+        m_end = m_begin + m_text.size();
+#else
+        auto fd = open(filename, O_RDONLY);
+        if (fd < 0)
+        {
+            return;
+        }
+
+        struct stat info;
+        if (fstat(fd, &info) == 0 && info.st_size > 0)
+        {
+            auto mapped = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapped != MAP_FAILED)
+            {
+                m_begin = static_cast<const char *>(mapped);
+                m_end = m_begin + info.st_size;
+            }
+        }
+
+        close(fd);
+#endif
+
+        count_words();
+    }
+
+    ProgramFile(const ProgramFile &) = delete;
+    ProgramFile & operator=(const ProgramFile &) = delete;
+
+    ~ProgramFile()
+    {
+#if !defined(_WIN32)
+        if (m_begin)
+        {
+            munmap(const_cast<char *>(m_begin), m_end - m_begin);
+        }
+#endif
+    }
+
+    size_t words() const
+    {
+        return m_words;
+    }
+
+    // Parses the words into `out`, which must have room for words() of them.
+    // Returns how many were parsed, which is fewer than words() only if the
+    // file is malformed.
+    size_t parse(int64_t * out) const
+    {
+        auto p = m_begin;
+        for (size_t i = 0; i < m_words; ++i)
+        {
+            p = skip_space(p);
+            if (p != m_end && *p == '+')
+            {
+                ++p;
+            }
+
+            auto [next, error] = std::from_chars(p, m_end, out[i]);
+            if (error != std::errc())
+            {
+                return i;
+            }
+
+            p = skip_space(next);
+            if (p != m_end && *p == ',')
+            {
+                ++p;
+            }
+        }
+
+        return m_words;
+    }
+
+private:
+    static bool is_space(char c)
+    {
+        return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+    }
+
+    const char * skip_space(const char * p) const
+    {
+        while (p != m_end && is_space(*p))
+        {
+            ++p;
+        }
+
+        return p;
+    }
+
+    // One word per comma, plus the last one unless the text ends in a comma.
+    void count_words()
+    {
+        auto last = m_end;
+        while (last != m_begin && is_space(last[-1]))
+        {
+            --last;
+        }
+
+        if (last == m_begin)
+        {
+            return;
+        }
+
+        m_words = count_byte(m_begin, last, ',') + ((last[-1] != ',') ? 1 : 0);
+    }
+
+    const char * m_begin;
+    const char * m_end;
+    size_t m_words;
+#if defined(_WIN32)
+    std::string m_text;
+#endif
+};
+
+// Appends the words of a comma-separated program file to `values`.
+inline void read_program(const char * filename, std::vector<int64_t> * values)
+{
+    ProgramFile file(filename);
+
+    auto offset = values->size();
+    values->resize(offset + file.words());
+    values->resize(offset + file.parse(values->data() + offset));
+}
+
+// FNV-1a over the little-endian bytes of each word.
+inline uint64_t program_checksum(const int64_t * words, size_t count)
+{
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < count; ++i)
+    {
+        auto word = static_cast<uint64_t>(words[i]);
+        for (int b = 0; b < 8; ++b)
+        {
+            hash ^= (word >> (b * 8)) & 0xFF;
+            hash *= 1099511628211ull;
+        }
+    }
+
+    return hash;
+}
+
+#endif
@@ -0,0 +1,149 @@
+#ifndef INTCODE_RING_BUFFER_H
+#define INTCODE_RING_BUFFER_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// A fixed-capacity single-producer/single-consumer queue. One thread may push
+// while another pops without locks; neither side ever allocates. The indices
+// grow without bound and are reduced modulo the capacity, which must be a
+// power of two.
+//
+// Copying is only safe while neither side is in use.
+template <typename T, size_t kCapacity>
+class RingBuffer
+{
+    static_assert(kCapacity > 0 && (kCapacity & (kCapacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+    RingBuffer()
+        : m_head(0)
+        , m_tail(0)
+    {}
+
+    RingBuffer(const RingBuffer & other)
+        : m_head(0)
+        , m_tail(0)
+    {
+        *this = other;
+    }
+
+    RingBuffer & operator=(const RingBuffer & other)
+    {
+        auto head = other.m_head.load(std::memory_order_relaxed);
+        auto tail = other.m_tail.load(std::memory_order_relaxed);
+        for (auto i = head; i != tail; ++i)
+        {
+            m_values[i & kMask] = other.m_values[i & kMask];
+        }
+
+        m_head.store(head, std::memory_order_relaxed);
+        m_tail.store(tail, std::memory_order_relaxed);
+
+        return *this;
+    }
+
+    ~RingBuffer() = default;
+
+    static constexpr size_t capacity()
+    {
+        return kCapacity;
+    }
+
+    size_t size() const
+    {
+        return m_tail.load(std::memory_order_acquire) - m_head.load(std::memory_order_acquire);
+    }
+
+    bool empty() const
+    {
+        return size() == 0;
+    }
+
+    bool full() const
+    {
+        return size() == kCapacity;
+    }
+
+    // Producer side.
+
+    bool push(const T & value)
+    {
+        auto tail = m_tail.load(std::memory_order_relaxed);
+        if (tail - m_head.load(std::memory_order_acquire) == kCapacity)
+        {
+            return false;
+        }
+
+        m_values[tail & kMask] = value;
+        m_tail.store(tail + 1, std::memory_order_release);
+
+        return true;
+    }
+
+    // Pushes as many of the values as fit and returns how many that was.
+    size_t push(const T * values, size_t count)
+    {
+        auto tail = m_tail.load(std::memory_order_relaxed);
+        count = std::min(count, kCapacity - (tail - m_head.load(std::memory_order_acquire)));
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            m_values[(tail + i) & kMask] = values[i];
+        }
+
+        m_tail.store(tail + count, std::memory_order_release);
+
+        return count;
+    }
+
+    // Consumer side.
+
+    bool pop(T * value)
+    {
+        auto head = m_head.load(std::memory_order_relaxed);
+        if (m_tail.load(std::memory_order_acquire) == head)
+        {
+            return false;
+        }
+
+        *value = m_values[head & kMask];
+        m_head.store(head + 1, std::memory_order_release);
+
+        return true;
+    }
+
+    // Pops up to `count` values and returns how many that was.
+    size_t pop(T * values, size_t count)
+    {
+        auto head = m_head.load(std::memory_order_relaxed);
+        count = std::min(count, static_cast<size_t>(m_tail.load(std::memory_order_acquire) - head));
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            values[i] = m_values[(head + i) & kMask];
+        }
+
+        m_head.store(head + count, std::memory_order_release);
+
+        return count;
+    }
+
+    void clear()
+    {
+        m_head.store(m_tail.load(std::memory_order_acquire), std::memory_order_release);
+    }
+
+private:
+    static constexpr size_t kMask = kCapacity - 1;
+
+    // NOTE: The indices live on separate cache lines so the producer and the
+    // consumer do not invalidate each other's line on every operation.
+    alignas(64) std::atomic<size_t> m_head;
+    alignas(64) std::atomic<size_t> m_tail;
+    alignas(64) T m_values[kCapacity];
+};
+
+#endif
@@ -0,0 +1,515 @@
+#ifndef INTCODE_SYMBOLIC_H
+#define INTCODE_SYMBOLIC_H
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "instruction.h"
+#include "memory.h"
+
+// A polynomial with integer coefficients over a small set of symbols, or
+// "unknown" once a value depends on something the symbolic machine could not
+// track (a load through a symbolic address, or a polynomial that grew too
+// large). Unknown values are harmless until something actually uses them.
+class Expression
+{
+public:
+    // A monomial is the sorted multiset of its symbol indices, one byte per
+    // factor, so x*x*y is "\0\0\1" and the constant term is the empty string.
+    using Monomial = std::string;
+
+    static constexpr size_t kMaxTerms = 256;
+
+    Expression(int64_t value = 0)
+        : m_unknown(false)
+    {
+        if (value != 0)
+        {
+            m_terms[Monomial{}] = value;
+        }
+    }
+
+    static Expression symbol(uint8_t index)
+    {
+        Expression e;
+        e.m_terms[Monomial(1, static_cast<char>(index))] = 1;
+
+        return e;
+    }
+
+    static Expression unknown()
+    {
+        Expression e;
+        e.m_unknown = true;
+
+        return e;
+    }
+
+    bool is_unknown() const
+    {
+        return m_unknown;
+    }
+
+    bool is_constant() const
+    {
+        return !m_unknown && (m_terms.empty() || (m_terms.size() == 1 && m_terms.begin()->first.empty()));
+    }
+
+    int64_t constant() const
+    {
+        auto it = m_terms.find(Monomial{});
+
+        return (it == m_terms.end()) ? 0 : it->second;
+    }
+
+    // Highest power of the symbol in any term.
+    int degree(uint8_t symbol) const
+    {
+        int degree = 0;
+        for (auto & term : m_terms)
+        {
+            degree = std::max(degree, static_cast<int>(std::count(term.first.begin(), term.first.end(), static_cast<char>(symbol))));
+        }
+
+        return degree;
+    }
+
+    int64_t evaluate(const std::vector<int64_t> & values) const
+    {
+        int64_t result = 0;
+        for (auto & term : m_terms)
+        {
+            auto product = term.second;
+            for (auto symbol : term.first)
+            {
+                product *= values[static_cast<uint8_t>(symbol)];
+            }
+
+            result += product;
+        }
+
+        return result;
+    }
+
+    friend Expression operator+(const Expression & lhs, const Expression & rhs)
+    {
+        if (lhs.m_unknown || rhs.m_unknown)
+        {
+            return unknown();
+        }
+
+        Expression result = lhs;
+        for (auto & term : rhs.m_terms)
+        {
+            result.add_term(term.first, term.second);
+        }
+
+        return result.limit();
+    }
+
+    friend Expression operator*(const Expression & lhs, const Expression & rhs)
+    {
+        if (lhs.m_unknown || rhs.m_unknown)
+        {
+            return unknown();
+        }
+
+        Expression result;
+        for (auto & a : lhs.m_terms)
+        {
+            for (auto & b : rhs.m_terms)
+            {
+                Monomial monomial;
+                std::merge(a.first.begin(), a.first.end(), b.first.begin(), b.first.end(), std::back_inserter(monomial));
+
+                result.add_term(monomial, a.second * b.second);
+            }
+        }
+
+        return result.limit();
+    }
+
+    std::string to_string(const std::vector<std::string> & names) const
+    {
+        if (m_unknown)
+        {
+            return "?";
+        }
+
+        if (m_terms.empty())
+        {
+            return "0";
+        }
+
+        std::string s;
+        for (auto & term : m_terms)
+        {
+            if (!s.empty())
+            {
+                s += " + ";
+            }
+
+            s += std::to_string(term.second);
+            for (auto symbol : term.first)
+            {
+                s += "*" + names[static_cast<uint8_t>(symbol)];
+            }
+        }
+
+        return s;
+    }
+
+private:
+    void add_term(const Monomial & monomial, int64_t coefficient)
+    {
+        auto & value = m_terms[monomial];
+        value += coefficient;
+
+        if (value == 0)
+        {
+            m_terms.erase(monomial);
+        }
+    }
+
+    Expression limit()
+    {
+        return (m_terms.size() > kMaxTerms) ? unknown() : *this;
+    }
+
+    bool m_unknown;
+    std::map<Monomial, int64_t> m_terms;
+};
+
+// Runs an Intcode program with some memory cells replaced by symbols. Add and
+// Multiply build polynomials over the symbols; everything that needs a
+// concrete value (the opcode word, a jump condition or target, a store
+// address, the relative base, input) stops the machine with NeedsConcrete so
+// the caller can fall back to ordinary execution. Memory is as large as the
+// interpreter's, and a concrete address outside it stops the machine with
+// InvalidInstruction, where the interpreter would fault.
+class SymbolicComputer
+{
+public:
+    enum State
+    {
+        Halted,
+        NeedsConcrete,
+        InvalidInstruction,
+    };
+
+    SymbolicComputer(const std::vector<int64_t> & program, size_t memorySize = Memory::kDefaultSize)
+        : m_pc(0)
+        , m_baseOffset(0)
+        , m_memorySize(std::max(memorySize, program.size()))
+        , m_memory(program.begin(), program.end())
+    {}
+
+    ~SymbolicComputer() = default;
+
+    uint8_t make_symbolic(int64_t address, const std::string & name)
+    {
+        auto index = static_cast<uint8_t>(m_names.size());
+        m_names.push_back(name);
+
+        write(address, Expression::symbol(index));
+
+        return index;
+    }
+
+    const std::vector<std::string> & symbols() const
+    {
+        return m_names;
+    }
+
+    Expression read(int64_t address) const
+    {
+        if (address < 0 || address >= static_cast<int64_t>(m_memory.size()))
+        {
+            return Expression();
+        }
+
+        return m_memory[address];
+    }
+
+    void write(int64_t address, const Expression & value)
+    {
+        assert(in_range(address));
+
+        if (address >= static_cast<int64_t>(m_memory.size()))
+        {
+            m_memory.resize(address + 1);
+        }
+
+        m_memory[address] = value;
+    }
+
+    State process()
+    {
+        for (; ; )
+        {
+            auto word = read(m_pc);
+            if (!word.is_constant())
+            {
+                return NeedsConcrete;
+            }
+
+            auto code = word.constant();
+            auto inst = decode_instruction(&code, 1);
+
+            switch (inst.opcode)
+            {
+                case Add:
+                case Multiply:
+                case LessThan:
+                case Equals:
+                {
+                    Expression op1;
+                    Expression op2;
+                    if (!evaluate_parameter(1, inst.param1Mode, &op1) || !evaluate_parameter(2, inst.param2Mode, &op2))
+                    {
+                        return InvalidInstruction;
+                    }
+
+                    int64_t result = 0;
+                    if (!evaluate_output(3, inst.param3Mode, &result))
+                    {
+                        return NeedsConcrete;
+                    }
+
+                    if (!in_range(result))
+                    {
+                        return InvalidInstruction;
+                    }
+
+                    Expression value;
+                    if (inst.opcode == Add)
+                    {
+                        value = op1 + op2;
+                    }
+                    else if (inst.opcode == Multiply)
+                    {
+                        value = op1 * op2;
+                    }
+                    else if (op1.is_constant() && op2.is_constant())
+                    {
+                        auto a = op1.constant();
+                        auto b = op2.constant();
+
+                        value = Expression((inst.opcode == LessThan) ? (a < b) : (a == b));
+                    }
+                    else
+                    {
+                        // NOTE: Comparisons only ever feed branches, so there is
+                        // little point in modelling them symbolically.
+                        value = Expression::unknown();
+                    }
+
+                    m_pc += 4;
+                    write(result, value);
+                } break;
+                case JumpIfTrue:
+                case JumpIfFalse:
+                {
+                    Expression op1;
+                    Expression op2;
+                    if (!evaluate_parameter(1, inst.param1Mode, &op1) || !evaluate_parameter(2, inst.param2Mode, &op2))
+                    {
+                        return InvalidInstruction;
+                    }
+
+                    if (!op1.is_constant() || !op2.is_constant())
+                    {
+                        return NeedsConcrete;
+                    }
+
+                    auto taken = (inst.opcode == JumpIfTrue) ? (op1.constant() != 0) : (op1.constant() == 0);
+
+                    m_pc = taken ? op2.constant() : m_pc + 3;
+                } break;
+                case RelativeBaseOffset:
+                {
+                    Expression op1;
+                    if (!evaluate_parameter(1, inst.param1Mode, &op1))
+                    {
+                        return InvalidInstruction;
+                    }
+
+                    if (!op1.is_constant())
+                    {
+                        return NeedsConcrete;
+                    }
+
+                    m_baseOffset += op1.constant();
+
+                    m_pc += 2;
+                } break;
+                case Input:
+                case Output:
+                {
+                    return NeedsConcrete;
+                } break;
+                case Halt:
+                {
+                    return Halted;
+                } break;
+                default:
+                {
+                    return InvalidInstruction;
+                } break;
+            }
+        }
+    }
+
+private:
+    bool in_range(int64_t address) const
+    {
+        return static_cast<uint64_t>(address) < m_memorySize;
+    }
+
+    // Returns false if the parameter loads from a concrete address outside
+    // memory.
+    bool evaluate_parameter(int64_t offset, ParameterMode mode, Expression * value) const
+    {
+        auto param = read(m_pc + offset);
+
+        if (mode == ParameterMode::ImmediateMode)
+        {
+            *value = param;
+            return true;
+        }
+
+        if (!param.is_constant())
+        {
+            // NOTE: A load through a symbolic address could read any cell.
+            // It only becomes a problem if the value is actually used.
+            *value = Expression::unknown();
+            return true;
+        }
+
+        auto address = param.constant() + ((mode == ParameterMode::RelativeMode) ? m_baseOffset : 0);
+        *value = read(address);
+
+        return in_range(address);
+    }
+
+    // Returns false if the address is symbolic; the caller checks a concrete
+    // one against the memory size.
+    bool evaluate_output(int64_t offset, ParameterMode mode, int64_t * address) const
+    {
+        auto param = read(m_pc + offset);
+        if (!param.is_constant())
+        {
+            return false;
+        }
+
+        *address = param.constant() + ((mode == ParameterMode::RelativeMode) ? m_baseOffset : 0);
+
+        return true;
+    }
+
+    int64_t m_pc;
+    int64_t m_baseOffset;
+    size_t m_memorySize;
+    std::vector<Expression> m_memory;
+    std::vector<std::string> m_names;
+};
+
+// Finds the first assignment (in lexicographic order of the symbols) within
+// the half-open bounds [first, second) for which the expression equals the
+// target. The last symbol is solved for directly when the expression is
+// linear in it; the others are enumerated.
+inline bool solve(const Expression & e, int64_t target,
+                  const std::vector<std::pair<int64_t, int64_t>> & bounds,
+                  std::vector<int64_t> * solution)
+{
+    if (e.is_unknown() || bounds.empty())
+    {
+        return false;
+    }
+
+    auto last = static_cast<uint8_t>(bounds.size() - 1);
+    auto linear = e.degree(last) <= 1;
+
+    std::vector<int64_t> values(bounds.size());
+    for (size_t i = 0; i < bounds.size(); ++i)
+    {
+        if (bounds[i].first >= bounds[i].second)
+        {
+            return false;
+        }
+
+        values[i] = bounds[i].first;
+    }
+
+    for (; ; )
+    {
+        if (linear)
+        {
+            // e = a * x + b, with a and b read off by evaluating at x = 0, 1.
+            values[last] = 0;
+            auto b = e.evaluate(values);
+            values[last] = 1;
+            auto a = e.evaluate(values) - b;
+
+            auto rest = target - b;
+            if (a == 0)
+            {
+                if (rest == 0)
+                {
+                    values[last] = bounds[last].first;
+                    *solution = values;
+
+                    return true;
+                }
+            }
+            else if (rest % a == 0)
+            {
+                auto x = rest / a;
+                if (bounds[last].first <= x && x < bounds[last].second)
+                {
+                    values[last] = x;
+                    *solution = values;
+
+                    return true;
+                }
+            }
+        }
+        else
+        {
+            for (auto x = bounds[last].first; x < bounds[last].second; ++x)
+            {
+                values[last] = x;
+                if (e.evaluate(values) == target)
+                {
+                    *solution = values;
+
+                    return true;
+                }
+            }
+        }
+
+        // Advance the remaining symbols like an odometer.
+        int i = static_cast<int>(last) - 1;
+        for (; i >= 0; --i)
+        {
+            if (++values[i] < bounds[i].second)
+            {
+                break;
+            }
+
+            values[i] = bounds[i].first;
+        }
+
+        if (i < 0)
+        {
+            return false;
+        }
+    }
+}
+
+#endif
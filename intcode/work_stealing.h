@@ -0,0 +1,139 @@
+#ifndef INTCODE_WORK_STEALING_H
+#define INTCODE_WORK_STEALING_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// A fixed set of workers, each with its own task deque. A worker takes the
+// newest task from its own deque, so it keeps working on the subtree it just
+// split, and steals the oldest task from another worker when it runs dry,
+// which is the biggest piece of work that worker had left.
+//
+// Tasks may spawn further tasks while they run. run() returns once every task
+// has been processed.
+template <typename Task>
+class WorkStealingPool
+{
+public:
+    explicit WorkStealingPool(size_t workers)
+        : m_queues(std::max<size_t>(workers, 1))
+        , m_pending(0)
+    {}
+
+    ~WorkStealingPool() = default;
+
+    size_t workers() const
+    {
+        return m_queues.size();
+    }
+
+    // Calls process(worker, task) for every task, with `worker` in
+    // [0, workers()). The calling thread is worker 0.
+    template <typename Process>
+    void run(const std::vector<Task> & tasks, Process process)
+    {
+        for (size_t i = 0; i < tasks.size(); ++i)
+        {
+            spawn(i % m_queues.size(), tasks[i]);
+        }
+
+        auto worker = [this, &process](size_t index)
+        {
+            Task task;
+            for (; ; )
+            {
+                if (pop(index, &task) || steal(index, &task))
+                {
+                    process(index, task);
+                    m_pending.fetch_sub(1, std::memory_order_acq_rel);
+
+                    continue;
+                }
+
+                if (m_pending.load(std::memory_order_acquire) == 0)
+                {
+                    return;
+                }
+
+                std::this_thread::yield();
+            }
+        };
+
+        std::vector<std::thread> threads;
+        for (size_t i = 1; i < m_queues.size(); ++i)
+        {
+            threads.emplace_back(worker, i);
+        }
+
+        worker(0);
+
+        for (auto & t : threads)
+        {
+            t.join();
+        }
+    }
+
+    // Queues a task on the given worker's deque. Only call this from that
+    // worker, or before run().
+    void spawn(size_t worker, Task task)
+    {
+        m_pending.fetch_add(1, std::memory_order_acq_rel);
+
+        auto & queue = m_queues[worker];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.tasks.push_back(std::move(task));
+    }
+
+private:
+    // NOTE: A plain lock per deque. Only thieves contend for it, and a thief
+    // takes a whole subtree at a time, so the lock is rarely contested.
+    struct alignas(64) Queue
+    {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    bool pop(size_t worker, Task * task)
+    {
+        auto & queue = m_queues[worker];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.tasks.empty())
+        {
+            return false;
+        }
+
+        *task = std::move(queue.tasks.back());
+        queue.tasks.pop_back();
+
+        return true;
+    }
+
+    bool steal(size_t worker, Task * task)
+    {
+        for (size_t i = 1; i < m_queues.size(); ++i)
+        {
+            auto & queue = m_queues[(worker + i) % m_queues.size()];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if (!queue.tasks.empty())
+            {
+                *task = std::move(queue.tasks.front());
+                queue.tasks.pop_front();
+
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    std::vector<Queue> m_queues;
+    std::atomic<size_t> m_pending;
+};
+
+#endif
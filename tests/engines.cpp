@@ -0,0 +1,572 @@
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../intcode/batch.h"
+#include "../intcode/checkpoint.h"
+#include "../intcode/computer.h"
+#include "../intcode/coroutine.h"
+#include "../intcode/image.h"
+#include "../intcode/jit.h"
+#include "../intcode/pool.h"
+#include "../intcode/program.h"
+#include "../intcode/symbolic.h"
+
+// NOTE: Built with -DINTCODE_AOT_PROGRAM=<symbol> and the output of
+// intcode2cpp, the translated program is checked as well, along with the
+// programs in tests/input translated under their file names. Every other
+// program falls back to the interpreter.
+#if defined(INTCODE_AOT_PROGRAM)
+    #include "../intcode/aot.h"
+
+    extern const CompiledProgram INTCODE_AOT_PROGRAM;
+    extern const CompiledProgram aot_relative_load;
+    extern const CompiledProgram aot_relative_store;
+
+    const CompiledProgram * const kCompiledPrograms[] = { &INTCODE_AOT_PROGRAM, &aot_relative_load, &aot_relative_store };
+#endif
+
+// Runs every execution engine on the same programs and checks that they all
+// agree with the interpreter on the final state, the output, the number of
+// executed instructions and the resulting memory.
+
+struct Case
+{
+    std::string name;
+    std::vector<int64_t> program;
+    std::vector<int64_t> input;
+};
+
+struct Result
+{
+    Computer::State state;
+    std::vector<int64_t> output;
+    uint64_t executed;
+    std::vector<int64_t> memory;
+};
+
+void expect(const std::string & engine, const Case & test, const Result & expected, const Result & actual);
+
+static int failures = 0;
+
+// Feeds the whole input up front, unless the machine has been started
+// already, and runs until it stops for any reason other than a full output
+// port.
+template <typename Vm, typename Process>
+Result run(Vm & c, const Case & test, Process process)
+{
+    if (!c.started())
+    {
+        c.push_input(test.input);
+    }
+
+    Result result;
+    for (; ; )
+    {
+        result.state = process();
+
+        auto output = c.get_output();
+        result.output.insert(result.output.end(), output.begin(), output.end());
+
+        if (result.state != Computer::WaitingForOutput)
+        {
+            break;
+        }
+    }
+
+    result.executed = c.instructions_executed();
+    for (size_t i = 0; i < test.program.size(); ++i)
+    {
+        result.memory.push_back(c.read(static_cast<int64_t>(i)));
+    }
+
+    return result;
+}
+
+template <typename Vm>
+Result interpret(const Case & test)
+{
+    Vm c(test.program);
+    return run(c, test, [&c]() { return c.process(); });
+}
+
+template <typename Features>
+Result jit(const Case & test)
+{
+    BasicComputer<Features> c(test.program);
+    BasicJit<Features> j(c);
+    return run(c, test, [&j]() { return j.process(); });
+}
+
+template <typename Vm>
+Result image(const Case & test)
+{
+    auto path = (std::filesystem::temp_directory_path() / "intcode-engines.img").string();
+
+    Vm c(std::vector<int64_t>{ 99 });
+    auto loaded = Image::save(test.program, path.c_str()) && Image::load(&c, path.c_str());
+    std::filesystem::remove(path);
+
+    if (!loaded)
+    {
+        return Result{ Computer::InvalidInstruction, {}, 0, {} };
+    }
+
+    return run(c, test, [&c]() { return c.process(); });
+}
+
+#if defined(INTCODE_AOT_PROGRAM)
+Result aot(const Case & test)
+{
+    auto compiled = kCompiledPrograms[0];
+    for (auto program : kCompiledPrograms)
+    {
+        if (program->size == test.program.size() && program->checksum == program_checksum(test.program.data(), test.program.size()))
+        {
+            compiled = program;
+        }
+    }
+
+    Computer c(test.program);
+    Aot a(c, *compiled);
+    return run(c, test, [&a]() { return a.process(); });
+}
+#endif
+
+// Drives the machine as a coroutine, handing it the input one value at a
+// time as it asks for it.
+Result coroutine(const Case & test)
+{
+    Computer c(test.program);
+    auto machine = Machine::run(c);
+
+    Result result;
+    size_t next = 0;
+    for (auto event = machine.resume(); ; )
+    {
+        if (event == Machine::HasOutput)
+        {
+            result.output.push_back(machine.value());
+            event = machine.resume();
+        }
+        else if (event == Machine::NeedsInput && next < test.input.size())
+        {
+            event = machine.resume(test.input[next++]);
+        }
+        else
+        {
+            result.state = (event == Machine::NeedsInput) ? Computer::WaitingForInput
+                : (event == Machine::Halted) ? Computer::Halted
+                : Computer::InvalidInstruction;
+            break;
+        }
+    }
+
+    result.executed = c.instructions_executed();
+    for (size_t i = 0; i < test.program.size(); ++i)
+    {
+        result.memory.push_back(c.read(static_cast<int64_t>(i)));
+    }
+
+    return result;
+}
+
+// Runs the program on a pooled machine, hands it back to the pool and runs
+// it again on the machine the pool reset.
+Result pooled(const Case & test)
+{
+    ComputerPool pool(test.program);
+
+    auto & first = pool.acquire();
+    run(first, test, [&first]() { return first.process(); });
+    pool.release(first);
+
+    auto & c = pool.acquire();
+    if (&c != &first)
+    {
+        return Result{ Computer::InvalidInstruction, {}, 0, {} };
+    }
+
+    return run(c, test, [&c]() { return c.process(); });
+}
+
+// Runs a few instructions, checkpoints the machine and finishes the run on
+// another one restored from the checkpoint.
+template <typename Vm>
+Result checkpoint(const Case & test)
+{
+    auto path = (std::filesystem::temp_directory_path() / "intcode-engines.ckpt").string();
+
+    Vm first(test.program);
+    first.push_input(test.input);
+    auto state = first.step(50);
+    auto stopped = state == Computer::Halted || state == Computer::InvalidInstruction;
+
+    Vm c(std::vector<int64_t>{ 99 });
+    auto restored = Checkpoint::save(first, path.c_str()) && Checkpoint::restore(&c, path.c_str());
+    std::filesystem::remove(path);
+
+    if (!restored)
+    {
+        return Result{ Computer::InvalidInstruction, {}, 0, {} };
+    }
+
+    // NOTE: A machine that has already stopped would run its last
+    // instruction again.
+    return run(c, test, [&c, state, stopped]() { return stopped ? state : c.process(); });
+}
+
+// Runs every case for `program` side by side on the lanes of a batch
+// machine, one case per lane and round robin over the lanes, and checks each
+// lane against the interpreter. Only programs that halt are supported in
+// lockstep, so only those are run.
+void batch(const std::vector<const Case *> & tests, const std::vector<Result> & expected)
+{
+    using Batch = BatchComputer<8>;
+
+    auto & program = tests.front()->program;
+    Batch b(program);
+
+    for (size_t lane = 0; lane < Batch::lanes(); ++lane)
+    {
+        for (auto value : tests[lane % tests.size()]->input)
+        {
+            b.push_input(lane, value);
+        }
+    }
+
+    std::vector<std::vector<int64_t>> output(Batch::lanes());
+    for (auto more = true; more; )
+    {
+        b.process();
+
+        more = false;
+        for (size_t lane = 0; lane < Batch::lanes(); ++lane)
+        {
+            for (int64_t value; b.pop_output(lane, &value); )
+            {
+                output[lane].push_back(value);
+            }
+
+            more = more || b.state(lane) == Computer::WaitingForOutput;
+        }
+    }
+
+    for (size_t lane = 0; lane < Batch::lanes(); ++lane)
+    {
+        auto & test = *tests[lane % tests.size()];
+        auto & want = expected[lane % tests.size()];
+
+        Result result{ b.state(lane), output[lane], want.executed, {} };
+        for (size_t i = 0; i < program.size(); ++i)
+        {
+            result.memory.push_back(b.read(lane, static_cast<int64_t>(i)));
+        }
+
+        expect(std::string("batch/") + Batch::simd_mode(), test, want, result);
+    }
+}
+
+// A damaged image must be turned down by load() rather than run.
+void expect_rejected(const std::vector<int64_t> & program)
+{
+    auto path = (std::filesystem::temp_directory_path() / "intcode-engines.img").string();
+    Image::save(program, path.c_str());
+
+    auto size = std::filesystem::file_size(path);
+    std::vector<char> bytes(size);
+    std::ifstream(path, std::ifstream::binary).read(bytes.data(), size);
+
+    auto reject = [&](const std::string & what, const std::vector<char> & damaged)
+    {
+        std::ofstream(path, std::ofstream::binary | std::ofstream::trunc).write(damaged.data(), damaged.size());
+
+        Computer c(std::vector<int64_t>{ 99 });
+        if (Image::load(&c, path.c_str()) || Image::verify(path.c_str()))
+        {
+            std::cerr << "image: accepted " << what << std::endl;
+            ++failures;
+        }
+    };
+
+    auto truncated = bytes;
+    truncated.resize(size / 2);
+    reject("a truncated file", truncated);
+
+    // The handler of the first cached instruction; the decode cache is the
+    // section after the memory image.
+    auto handler = bytes;
+    handler[2 * Image::kAlignment + 2] = static_cast<char>(0xFF);
+    reject("an out of range handler", handler);
+
+    std::filesystem::remove(path);
+}
+
+// Likewise for a damaged checkpoint, which restore() must turn down without
+// touching the machine.
+void expect_restore_rejected(const Case & test)
+{
+    auto path = (std::filesystem::temp_directory_path() / "intcode-engines.ckpt").string();
+
+    Computer first(test.program);
+    first.push_input(test.input);
+    first.step(50);
+    Checkpoint::save(first, path.c_str());
+
+    auto size = std::filesystem::file_size(path);
+    std::vector<char> bytes(size);
+    std::ifstream(path, std::ifstream::binary).read(bytes.data(), size);
+
+    auto reject = [&](const std::string & what, const std::vector<char> & damaged)
+    {
+        std::ofstream(path, std::ofstream::binary | std::ofstream::trunc).write(damaged.data(), damaged.size());
+
+        Computer c(std::vector<int64_t>{ 99 });
+        if (Checkpoint::restore(&c, path.c_str()) || c.read(0) != 99)
+        {
+            std::cerr << "checkpoint: accepted " << what << std::endl;
+            ++failures;
+        }
+    };
+
+    // The last page is mapped from past the end of the file.
+    auto truncated = bytes;
+    truncated.resize(size - Memory::page_size() / 2);
+    reject("a truncated file", truncated);
+
+    // The memory size, after the magic, version, page size, flags and the
+    // three registers.
+    auto huge = bytes;
+    uint64_t words = uint64_t(1) << 62;
+    std::memcpy(huge.data() + 48, &words, sizeof(words));
+    reject("an oversized memory", huge);
+
+    std::filesystem::remove(path);
+}
+
+// Day 2 asks for the noun and verb, at addresses 1 and 2, that leave
+// `target` at address 0. Solving the symbolic run must find the same first
+// pair as trying them all, and a program the symbolic machine cannot finish
+// must be left to the search.
+void expect_solved(const Case & test, int64_t target, bool symbolic)
+{
+    SymbolicComputer s(test.program);
+    s.make_symbolic(1, "noun");
+    s.make_symbolic(2, "verb");
+
+    auto finished = s.process() == SymbolicComputer::Halted && !s.read(0).is_unknown();
+    if (finished != symbolic)
+    {
+        std::cerr << "symbolic on " << test.name << ": " << (finished ? "halted" : "did not halt") << std::endl;
+        ++failures;
+        return;
+    }
+
+    std::vector<int64_t> searched;
+    for (int64_t noun = 0; noun < 100 && searched.empty(); ++noun)
+    {
+        for (int64_t verb = 0; verb < 100 && searched.empty(); ++verb)
+        {
+            auto program = test.program;
+            program[1] = noun;
+            program[2] = verb;
+
+            BasicComputer<BasicFeatures, NoIO> c(program);
+            if (c.process() == Computer::Halted && c.read(0) == target)
+            {
+                searched = { noun, verb };
+            }
+        }
+    }
+
+    std::vector<int64_t> solved;
+    if (finished && !solve(s.read(0), target, { { 0, 100 }, { 0, 100 } }, &solved))
+    {
+        solved.clear();
+    }
+
+    if (finished && solved != searched)
+    {
+        std::cerr << "symbolic on " << test.name << ": solved a different noun and verb" << std::endl;
+        ++failures;
+    }
+}
+
+void expect(const std::string & engine, const Case & test, const Result & expected, const Result & actual)
+{
+    std::string what;
+    if (actual.state != expected.state)
+    {
+        what = "state " + std::to_string(actual.state) + " instead of " + std::to_string(expected.state);
+    }
+    else if (actual.output != expected.output)
+    {
+        what = "different output";
+    }
+    else if (actual.executed != expected.executed)
+    {
+        what = std::to_string(actual.executed) + " instructions instead of " + std::to_string(expected.executed);
+    }
+    else if (actual.memory != expected.memory)
+    {
+        what = "different memory";
+    }
+    else
+    {
+        return;
+    }
+
+    std::cerr << engine << " on " << test.name << ": " << what << std::endl;
+    ++failures;
+}
+
+int main(int argc, char ** argv)
+{
+    if (argc < 2)
+    {
+        std::cerr << "usage: " << argv[0] << " <source directory>" << std::endl;
+        return 2;
+    }
+
+#if defined(__AVX2__)
+    if (!__builtin_cpu_supports("avx2"))
+    {
+        std::cout << "skipped: this CPU does not have AVX2" << std::endl;
+        return 77;
+    }
+#endif
+
+    std::string root = argv[1];
+
+    std::vector<Case> cases = {
+        // Self-modifying: the first instruction writes the output address of
+        // the second.
+        { "patch-ahead", { 1101, 42, 0, 5, 1101, 7, 0, 100, 4, 100, 99 }, {} },
+        // Self-modifying loop that bumps the operand of an instruction it
+        // runs on every iteration.
+        { "patch-loop", { 1101, 0, 0, 50, 1001, 50, 1, 50, 1001, 13, 1, 13, 1101, 0, 0, 51, 1007, 50, 5, 60, 1005, 60, 4, 4, 13, 4, 51, 99 }, {} },
+        // A compare that overwrites the jump right behind it.
+        { "patch-jump", { 1107, 1, 2, 6, 1005, 6, 77, 99, 4, 1005, 99 }, {} },
+        // A relative address far below memory; used to hang the JIT.
+        { "relative-underflow", { 109, -100000, 22201, 0, 0, 0, 99 }, {} },
+        { "relative-overflow", { 109, 1LL << 40, 204, 0, 99 }, {} },
+        { "position-overflow", { 1, 1LL << 40, 0, 0, 99 }, {} },
+        // Well past the program, but inside the interpreter's memory.
+        { "store-past-end", { 1101, 7, 8, 1000000, 4, 1000000, 99 }, {} },
+        // Mode digit 3 names no mode, except on a parameter that is not there.
+        { "bad-mode", { 304, 0, 99 }, {} },
+        { "unused-mode", { 30104, 7, 99 }, {} },
+    };
+
+    std::vector<std::pair<std::string, std::vector<int64_t>>> inputs = {
+        { "day-2", {} },
+        { "day-5", { 1 } },
+        { "day-5", { 5 } },
+        { "day-9", { 1 } },
+        { "day-9", { 2 } },
+    };
+
+    // A long run of compares with no jump after any of them. Looking for
+    // one used to decode the next compare, and so on, one stack frame each.
+    {
+        constexpr int64_t kCompares = 200000;
+
+        Case test{ "compare-chain", {}, {} };
+        for (int64_t i = 0; i < kCompares; ++i)
+        {
+            test.program.insert(test.program.end(), { 1107, i, 2, 4 * kCompares + 1 });
+        }
+
+        test.program.insert(test.program.end(), { 99, 0 });
+        cases.push_back(test);
+    }
+
+    // Out-of-range addresses in code that is translated ahead of time.
+    for (auto name : { "aot_relative_load", "aot_relative_store" })
+    {
+        Case test{ name, {}, {} };
+        read_program((root + "/tests/input/" + name + ".txt").c_str(), &test.program);
+        cases.push_back(test);
+    }
+
+    for (auto & [day, input] : inputs)
+    {
+        Case test{ input.empty() ? day : day + " with " + std::to_string(input.front()), {}, input };
+        read_program((root + "/" + day + "/input/input.txt").c_str(), &test.program);
+        cases.push_back(test);
+    }
+
+    std::vector<Result> expected;
+    for (auto & test : cases)
+    {
+        expected.push_back(interpret<Computer>(test));
+        expect("jit", test, expected.back(), jit<AllFeatures>(test));
+        expect("image", test, expected.back(), image<Computer>(test));
+        expect("checkpoint", test, expected.back(), checkpoint<Computer>(test));
+        expect("coroutine", test, expected.back(), coroutine(test));
+        expect("pool", test, expected.back(), pooled(test));
+#if defined(INTCODE_AOT_PROGRAM)
+        expect("aot", test, expected.back(), aot(test));
+#endif
+    }
+
+    // A machine without relative mode must reject the same code whichever
+    // way it runs.
+    using Basic = BasicComputer<BasicFeatures>;
+    for (auto & test : cases)
+    {
+        auto basic = interpret<Basic>(test);
+        expect("basic/jit", test, basic, jit<BasicFeatures>(test));
+        expect("basic/image", test, basic, image<Basic>(test));
+        expect("basic/checkpoint", test, basic, checkpoint<Basic>(test));
+    }
+
+    // Cases that share a program run together on one batch machine.
+    std::vector<bool> batched(cases.size(), false);
+    for (size_t i = 0; i < cases.size(); ++i)
+    {
+        std::vector<const Case *> tests;
+        std::vector<Result> results;
+        for (size_t j = i; j < cases.size(); ++j)
+        {
+            if (!batched[j] && cases[j].program == cases[i].program && expected[j].state == Computer::Halted)
+            {
+                batched[j] = true;
+                tests.push_back(&cases[j]);
+                results.push_back(expected[j]);
+            }
+        }
+
+        if (!tests.empty())
+        {
+            batch(tests, results);
+        }
+    }
+
+    expect_rejected(cases.back().program);
+    expect_restore_rejected(cases.back());
+
+    for (auto & test : cases)
+    {
+        if (test.name == "day-2")
+        {
+            expect_solved(test, 19690720, true);
+        }
+    }
+
+    // The noun and verb are added and stored far outside memory.
+    expect_solved({ "symbolic-overflow", { 1101, 1, 1, 4000000000000, 99 }, {} }, 2, false);
+
+    if (failures)
+    {
+        std::cerr << failures << " failures" << std::endl;
+        return 1;
+    }
+
+    std::cout << cases.size() << " programs agree" << std::endl;
+    return 0;
+}
@@ -0,0 +1,434 @@
+// Times each day's core functions on the inputs in day-*/input and prints the
+// results as JSON on stdout.
+//
+//     benchmark [root] [repetitions] [warmup]
+//
+// `root` is the repository root, which holds the day-* directories. Every
+// benchmark runs `warmup` untimed iterations and then `repetitions` timed
+// ones, and reports the median and 99th percentile wall time of a single
+// iteration. The virtual machine benchmarks also report instructions per
+// second at the median.
+
+// Everything the days include is included here first, at global scope, so
+// that the include guards keep it out of the namespaces below.
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <memory>
+#include <span>
+#include <sstream>
+#include <stack>
+#include <streambuf>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "../intcode/batch.h"
+#include "../intcode/computer.h"
+#include "../intcode/console.h"
+#include "../intcode/coroutine.h"
+#include "../intcode/image.h"
+#include "../intcode/jit.h"
+#include "../intcode/pipeline.h"
+#include "../intcode/pool.h"
+#include "../intcode/program.h"
+#include "../intcode/symbolic.h"
+#include "../intcode/work_stealing.h"
+#include "../day-7/permutation.h"
+
+// NOTE: Each day is a single translation unit with its own main(), so the
+// days are compiled in here, each in a namespace of its own, rather than
+// split into libraries. Their main() functions are renamed and never called.
+#define main day_main
+
+namespace day1 {
+#include "../day-1/main.cpp"
+}
+
+namespace day2 {
+#include "../day-2/main.cpp"
+}
+
+namespace day3 {
+#include "../day-3/main.cpp"
+}
+
+namespace day4 {
+#include "../day-4/main.cpp"
+}
+
+namespace day6 {
+#include "../day-6/main.cpp"
+}
+
+namespace day7 {
+#include "../day-7/main.cpp"
+}
+
+namespace day8 {
+#include "../day-8/main.cpp"
+}
+
+namespace day9 {
+#include "../day-9/main.cpp"
+}
+
+#undef main
+
+// Swallows whatever the days print while they are being timed.
+class NullBuffer : public std::streambuf
+{
+protected:
+    int overflow(int c) override
+    {
+        return c;
+    }
+};
+
+// Keeps the compiler from discarding a result that is never used.
+template <typename T>
+void keep(const T & value)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : "g"(&value) : "memory");
+#else
+    (void)value;
+#endif
+}
+
+struct Result
+{
+    std::string name;
+    double median;
+    double p99;
+    // Instructions per iteration, for the virtual machines, or zero.
+    uint64_t instructions;
+};
+
+// Runs `iteration` and returns the timings of the repetitions. The iteration
+// returns how many Intcode instructions it executed, if any.
+Result measure(const std::string & name, int repetitions, int warmup, const std::function<uint64_t()> & iteration)
+{
+    NullBuffer sink;
+    auto previous = std::cout.rdbuf(&sink);
+
+    uint64_t instructions = 0;
+    for (int i = 0; i < warmup; ++i)
+    {
+        instructions = iteration();
+    }
+
+    std::vector<double> seconds(repetitions);
+    for (auto & s : seconds)
+    {
+        auto start = std::chrono::steady_clock::now();
+        instructions = iteration();
+        auto end = std::chrono::steady_clock::now();
+
+        s = std::chrono::duration<double>(end - start).count();
+    }
+
+    std::cout.rdbuf(previous);
+
+    std::sort(seconds.begin(), seconds.end());
+
+    Result result;
+    result.name = name;
+    result.median = seconds[seconds.size() / 2];
+    result.p99 = seconds[std::min(seconds.size() - 1, static_cast<size_t>(std::ceil(seconds.size() * 0.99)) - 1)];
+    result.instructions = instructions;
+
+    return result;
+}
+
+std::vector<std::string> read_lines(const std::string & filename)
+{
+    std::ifstream fs(filename);
+
+    std::vector<std::string> lines;
+    for (std::string s; std::getline(fs, s); )
+    {
+        lines.push_back(s);
+    }
+
+    return lines;
+}
+
+std::vector<int64_t> read_intcode(const std::string & filename)
+{
+    std::vector<int64_t> program;
+    read_program(filename.c_str(), &program);
+
+    return program;
+}
+
+// Runs a machine to completion with a single input value, discarding its
+// output, and returns how many instructions it executed.
+template <typename Vm, typename Process>
+uint64_t run_intcode(Vm & c, int64_t input, Process process)
+{
+    c.push_input(input);
+    day9::run_discarding_output(c, process);
+
+    return c.instructions_executed();
+}
+
+void print_json(std::ostream & out, const std::vector<Result> & results, int repetitions, int warmup)
+{
+    out << "{\n";
+    out << "  \"repetitions\": " << repetitions << ",\n";
+    out << "  \"warmup\": " << warmup << ",\n";
+    out << "  \"benchmarks\": [\n";
+
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        auto & r = results[i];
+
+        out << "    { \"name\": \"" << r.name << "\""
+            << ", \"median_ns\": " << static_cast<uint64_t>(r.median * 1e9)
+            << ", \"p99_ns\": " << static_cast<uint64_t>(r.p99 * 1e9);
+
+        if (r.instructions > 0)
+        {
+            out << ", \"instructions\": " << r.instructions
+                << ", \"instructions_per_second\": " << static_cast<uint64_t>(r.instructions / r.median);
+        }
+
+        out << " }" << ((i + 1 < results.size()) ? "," : "") << "\n";
+    }
+
+    out << "  ]\n";
+    out << "}\n";
+}
+
+int main(int argc, char * argv[])
+{
+    std::string root = (argc > 1) ? argv[1] : ".";
+    int repetitions = (argc > 2) ? std::max(std::stoi(argv[2]), 1) : 20;
+    int warmup = (argc > 3) ? std::max(std::stoi(argv[3]), 0) : 3;
+
+    auto path = [&root](const std::string & file) { return root + "/" + file; };
+
+    std::vector<Result> results;
+    auto run = [&](const std::string & name, const std::function<uint64_t()> & iteration)
+    {
+        results.push_back(measure(name, repetitions, warmup, iteration));
+    };
+
+    // Day 1
+    {
+        auto filename = path("day-1/input.txt");
+
+        run("day-1/part1", [&]() { keep(day1::part1(filename)); return 0; });
+        run("day-1/part2", [&]() { keep(day1::part2(filename)); return 0; });
+    }
+
+    // Day 2
+    {
+        auto program = read_intcode(path("day-2/input/input.txt"));
+        day2::SearchSpace space{ 0, 100, 0, 100, 19690720 };
+
+        run("day-2/solve_symbolic", [&]()
+        {
+            day2::SearchResult result{ false, 0, 0 };
+            day2::solve_symbolic(program, space, &result);
+            keep(result);
+            return 0;
+        });
+        run("day-2/search", [&]() { keep(day2::search(program, space, 1)); return 0; });
+
+        // One concrete run, on the full machine and on one built for day 2.
+        auto concrete = program;
+        day2::part1(&concrete);
+
+        run("day-2/interpreter", [&]()
+        {
+            Computer c(concrete);
+            c.process();
+            keep(c.read(0));
+            return c.instructions_executed();
+        });
+        run("day-2/interpreter_basic", [&]()
+        {
+            BasicComputer<BasicFeatures, NoIO> c(concrete);
+            c.process();
+            keep(c.read(0));
+            return c.instructions_executed();
+        });
+    }
+
+    // Day 3
+    {
+        auto lines = read_lines(path("day-3/input/input.txt"));
+
+        std::vector<std::vector<day3::Line>> sets;
+        for (auto & line : lines)
+        {
+            sets.push_back(day3::make_line_segments(line));
+        }
+
+        run("day-3/make_line_segments", [&]()
+        {
+            for (auto & line : lines)
+            {
+                keep(day3::make_line_segments(line));
+            }
+            return 0;
+        });
+        run("day-3/find_intersections", [&]() { keep(day3::find_intersections(sets[0], sets[1])); return 0; });
+        run("day-3/find_intersections2", [&]() { keep(day3::find_intersections2(sets[0], sets[1])); return 0; });
+    }
+
+    // Day 4
+    {
+        // The puzzle input is the range, as "first-last".
+        int64_t first = 0;
+        int64_t last = -1;
+        char dash = 0;
+        std::ifstream fs(path("day-4/input/input.txt"));
+        fs >> first >> dash >> last;
+
+        std::vector<std::string> passwords;
+        for (auto i = first; i <= last; ++i)
+        {
+            passwords.push_back(std::to_string(i));
+        }
+
+        run("day-4/validate_password", [&]()
+        {
+            int count = 0;
+            for (auto & password : passwords)
+            {
+                count += day4::validate_password(password) ? 1 : 0;
+            }
+            keep(count);
+            return 0;
+        });
+    }
+
+    // Day 5
+    {
+        auto program = read_intcode(path("day-5/input/input.txt"));
+
+        run("day-5/interpreter", [&]() { Computer c(program); return run_intcode(c, 5, [&c]() { return c.process(); }); });
+        run("day-5/interpreter_basic", [&]()
+        {
+            BasicComputer<BasicFeatures> c(program);
+            return run_intcode(c, 5, [&c]() { return c.process(); });
+        });
+    }
+
+    // Day 6
+    {
+        std::vector<day6::OrbitPair> orbits;
+        for (auto & line : read_lines(path("day-6/input/input.txt")))
+        {
+            orbits.push_back(day6::make_orbit_pair(line));
+        }
+
+        // NOTE: make_orbit_tree() consumes its input, so every iteration
+        // also pays for copying the orbit list.
+        run("day-6/make_orbit_tree", [&]()
+        {
+            auto copy = orbits;
+            keep(day6::make_orbit_tree(copy));
+            return 0;
+        });
+
+        auto copy = orbits;
+        auto root = day6::make_orbit_tree(copy);
+
+        run("day-6/total_count", [&]() { keep(day6::total_count(root.get())); return 0; });
+        run("day-6/find_orbital_transfers", [&]() { keep(day6::find_orbital_transfers(root.get())); return 0; });
+    }
+
+    // Day 7
+    {
+        auto program = read_intcode(path("day-7/input/input.txt"));
+
+        run("day-7/search_chain", [&]() { keep(day7::search_chain(program, { 0, 1, 2, 3, 4 }, 1)); return 0; });
+        run("day-7/search_phases", [&]()
+        {
+            keep(day7::search_phases(program, { 5, 6, 7, 8, 9 }, 1, day7::run_feedback_loop));
+            return 0;
+        });
+    }
+
+    // Day 8
+    {
+        auto image = day8::read_input(path("day-8/input/input.txt").c_str(), 25, 6);
+
+        run("day-8/part1", [&]() { day8::part1(image); return 0; });
+        run("day-8/part2", [&]() { day8::part2(image); return 0; });
+    }
+
+    // Day 9
+    {
+        auto program = read_intcode(path("day-9/input/input.txt"));
+
+        run("day-9/interpreter", [&]() { Computer c(program); return run_intcode(c, 2, [&c]() { return c.process(); }); });
+        run("day-9/jit", [&]()
+        {
+            Computer c(program);
+            Jit jit(c);
+            return run_intcode(c, 2, [&jit]() { return jit.process(); });
+        });
+
+        // A short run, where building the machine would cost as much as
+        // running it.
+        ComputerPool pool(program);
+        run("day-9/pooled", [&]()
+        {
+            auto & c = pool.acquire();
+            auto executed = run_intcode(c, 1, [&c]() { return c.process(); });
+            pool.release(c);
+            return executed;
+        });
+        run("day-9/rebuilt", [&]() { Computer c(program); return run_intcode(c, 1, [&c]() { return c.process(); }); });
+    }
+
+    // Intcode loader
+    {
+        auto filename = path("day-9/input/input.txt");
+
+        run("intcode/read_program", [&]()
+        {
+            std::vector<int64_t> program;
+            read_program(filename.c_str(), &program);
+            keep(program);
+            return 0;
+        });
+
+        auto program = read_intcode(filename);
+        auto image = (std::filesystem::temp_directory_path() / "intcode-benchmark.img").string();
+        if (Image::save(program, image.c_str()))
+        {
+            run("intcode/image_load", [&]()
+            {
+                Computer c(std::vector<int64_t>{});
+                Image::load(&c, image.c_str());
+                keep(c);
+                return 0;
+            });
+
+            std::filesystem::remove(image);
+        }
+    }
+
+    print_json(std::cout, results, repetitions, warmup);
+
+    return 0;
+}
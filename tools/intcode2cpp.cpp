@@ -0,0 +1,401 @@
+// Translates an Intcode program into a C++ translation unit that runs it
+// through the Aot interface in intcode/aot.h.
+//
+//     intcode2cpp <program> <symbol> [output]
+//
+// The output defines `const CompiledProgram <symbol>` and is compiled with the
+// repository root on the include path.
+
+#include <climits>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "../intcode/instruction.h"
+#include "../intcode/memory.h"
+#include "../intcode/program.h"
+
+std::string literal(int64_t value)
+{
+    if (value == INT64_MIN)
+    {
+        return "INT64_MIN";
+    }
+
+    return "INT64_C(" + std::to_string(value) + ")";
+}
+
+std::string load(int64_t value, ParameterMode mode)
+{
+    switch (mode)
+    {
+        case ParameterMode::PositionMode:  { return "vm.load(" + literal(value) + ")";           } break;
+        case ParameterMode::ImmediateMode: { return literal(value);                               } break;
+        case ParameterMode::RelativeMode:  { return "vm.load(base + " + literal(value) + ")";    } break;
+    }
+
+    return literal(value);
+}
+
+std::string address(int64_t value, ParameterMode mode)
+{
+    return (mode == ParameterMode::RelativeMode) ? "base + " + literal(value) : literal(value);
+}
+
+bool writes_memory(uint8_t opcode)
+{
+    return opcode == Add || opcode == Multiply || opcode == Input || opcode == LessThan || opcode == Equals;
+}
+
+// The mode a parameter is accessed with. The interpreter treats an immediate
+// destination as an absolute address.
+ParameterMode access_mode(const Instruction & inst, int index)
+{
+    ParameterMode modes[] = { inst.param1Mode, inst.param2Mode, inst.param3Mode };
+
+    auto destination = writes_memory(inst.opcode) && index == inst.length - 2;
+    if (destination && modes[index] == ParameterMode::ImmediateMode)
+    {
+        return ParameterMode::PositionMode;
+    }
+
+    return modes[index];
+}
+
+class Translator
+{
+public:
+    Translator(const std::vector<int64_t> & program)
+        : m_program(program)
+        , m_code(program.size(), false)
+        , m_dynamicJumps(false)
+    {
+        discover();
+    }
+
+    void write(std::ostream & os, const std::string & source, const std::string & symbol)
+    {
+        os << "// Generated by intcode2cpp from " << source << ". Do not edit.\n\n";
+        os << "#include <cstdint>\n\n";
+        os << "#include \"intcode/aot.h\"\n\n";
+        os << "namespace\n{\n\n";
+
+        write_code_map(os);
+
+        os << "Computer::State run(Aot & vm)\n{\n";
+        os << "    int64_t base = vm.base();\n";
+        os << "    int64_t pc = vm.pc();\n";
+        os << "    uint64_t executed = 0;\n\n";
+        std::ostringstream body;
+        for (auto start : m_starts)
+        {
+            write_instruction(body, start);
+        }
+
+        // NOTE: The label is only emitted when a computed jump needs it, to
+        // keep -Wunused-label quiet.
+        if (m_dynamicJumps)
+        {
+            os << "dispatch:\n";
+        }
+
+        os << "    switch (pc)\n    {\n";
+        for (auto start : m_starts)
+        {
+            os << "        case " << start << ": goto L" << start << ";\n";
+        }
+        os << "        default: return vm.deoptimize(pc, base, executed);\n";
+        os << "    }\n\n";
+        os << body.str();
+        os << "}\n\n";
+        os << "}\n\n";
+        os << "extern const CompiledProgram " << symbol << " =\n{\n";
+        os << "    \"" << symbol << "\",\n";
+        os << "    " << m_program.size() << ",\n";
+        os << "    " << program_checksum(m_program.data(), m_program.size()) << "ull,\n";
+        os << "    run,\n";
+        os << "};\n";
+    }
+
+private:
+    Instruction decode(int64_t pc) const
+    {
+        return decode_instruction(m_program.data() + pc, m_program.size() - pc);
+    }
+
+    // Whether the instruction is translated. Like the interpreter's
+    // validate(), this turns down a fixed address outside the default
+    // memory, which is left to the interpreter to reject.
+    bool complete(int64_t pc, const Instruction & inst) const
+    {
+        for (int i = 0; i + 1 < inst.length; ++i)
+        {
+            if (access_mode(inst, i) == ParameterMode::PositionMode
+                && static_cast<uint64_t>(inst.params[i]) >= Memory::kDefaultSize)
+            {
+                return false;
+            }
+        }
+
+        return inst.opcode != Undecoded
+            && inst.length <= 4
+            && pc + inst.length <= static_cast<int64_t>(m_program.size())
+            && (inst.length > 1 || inst.opcode == Halt);
+    }
+
+    // Follows fall-through and immediate jump targets from address 0. Any
+    // other target is resolved at run time through the dispatch switch.
+    void discover()
+    {
+        std::vector<int64_t> work{ 0 };
+        while (!work.empty())
+        {
+            auto pc = work.back();
+            work.pop_back();
+
+            if (pc < 0 || pc >= static_cast<int64_t>(m_program.size()) || m_starts.count(pc))
+            {
+                continue;
+            }
+
+            auto inst = decode(pc);
+            if (!complete(pc, inst))
+            {
+                continue;
+            }
+
+            m_starts.insert(pc);
+            for (auto i = 0; i < inst.length; ++i)
+            {
+                m_code[pc + i] = true;
+            }
+
+            switch (inst.opcode)
+            {
+                case Halt:
+                {
+                } break;
+                case JumpIfTrue:
+                case JumpIfFalse:
+                {
+                    if (inst.param2Mode == ParameterMode::ImmediateMode)
+                    {
+                        work.push_back(inst.params[1]);
+                    }
+
+                    work.push_back(pc + inst.length);
+                } break;
+                default:
+                {
+                    work.push_back(pc + inst.length);
+                } break;
+            }
+        }
+    }
+
+    void write_code_map(std::ostream & os)
+    {
+        os << "const int64_t kSize = " << m_program.size() << ";\n\n";
+        os << "const bool kCode[] =\n{";
+        for (size_t i = 0; i < m_code.size(); ++i)
+        {
+            os << ((i % 32 == 0) ? "\n    " : " ") << (m_code[i] ? 1 : 0) << ",";
+        }
+        os << "\n};\n\n";
+        os << "inline bool is_code(int64_t address)\n{\n";
+        os << "    return 0 <= address && address < kSize && kCode[address];\n";
+        os << "}\n\n";
+    }
+
+    // Continues at `pc`, directly if it was translated and through the
+    // interpreter otherwise.
+    std::string jump(int64_t pc) const
+    {
+        if (m_starts.count(pc))
+        {
+            return "goto L" + std::to_string(pc) + ";";
+        }
+
+        return "return vm.deoptimize(" + std::to_string(pc) + ", base, executed);";
+    }
+
+    // Checks every address the instruction at `pc` uses that may fall outside
+    // memory, before the instruction has any effect: relative ones, and
+    // fixed ones past the program, since the machine's memory may be smaller
+    // than the default. One that does sends the instruction to the
+    // interpreter, which reports it.
+    void write_range_checks(std::ostream & os, int64_t pc, const Instruction & inst) const
+    {
+        for (int i = 0; i + 1 < inst.length; ++i)
+        {
+            auto mode = access_mode(inst, i);
+            auto beyond = mode == ParameterMode::PositionMode && inst.params[i] >= static_cast<int64_t>(m_program.size());
+            if (mode == ParameterMode::RelativeMode || beyond)
+            {
+                os << "        if (!vm.in_range(" << address(inst.params[i], mode) << ")) { return vm.deoptimize(" << pc << ", base, executed); }\n";
+            }
+        }
+    }
+
+    // Stores `value` and deoptimizes if the store hit translated code.
+    void write_store(std::ostream & os, int64_t param, ParameterMode mode, const std::string & value, int64_t next)
+    {
+        if (mode == ParameterMode::ImmediateMode)
+        {
+            // NOTE: The interpreter treats an immediate destination as an
+            // absolute address, so do the same here.
+            mode = ParameterMode::PositionMode;
+        }
+
+        os << "        int64_t address = " << address(param, mode) << ";\n";
+        os << "        vm.store(address, " << value << ");\n";
+
+        if (mode == ParameterMode::RelativeMode)
+        {
+            os << "        if (is_code(address)) { return vm.deoptimize(" << next << ", base, executed); }\n";
+        }
+        else if (0 <= param && param < static_cast<int64_t>(m_code.size()) && m_code[param])
+        {
+            os << "        return vm.deoptimize(" << next << ", base, executed);\n";
+        }
+    }
+
+    void write_instruction(std::ostream & os, int64_t pc)
+    {
+        auto inst = decode(pc);
+        auto next = pc + inst.length;
+
+        os << "L" << pc << ": //";
+        for (auto i = 0; i < inst.length; ++i)
+        {
+            os << " " << m_program[pc + i];
+        }
+        os << "\n    {\n";
+
+        write_range_checks(os, pc, inst);
+
+        // NOTE: I/O that has to wait is not counted, as in the interpreter.
+        if (inst.opcode != Input && inst.opcode != Output)
+        {
+            os << "        ++executed;\n";
+        }
+
+        auto op1 = load(inst.params[0], inst.param1Mode);
+        auto op2 = load(inst.params[1], inst.param2Mode);
+
+        switch (inst.opcode)
+        {
+            case Add:
+            {
+                write_store(os, inst.params[2], inst.param3Mode, "aot_add(" + op1 + ", " + op2 + ")", next);
+                os << "        " << jump(next) << "\n";
+            } break;
+            case Multiply:
+            {
+                write_store(os, inst.params[2], inst.param3Mode, "aot_mul(" + op1 + ", " + op2 + ")", next);
+                os << "        " << jump(next) << "\n";
+            } break;
+            case LessThan:
+            {
+                write_store(os, inst.params[2], inst.param3Mode, "(" + op1 + " < " + op2 + ") ? 1 : 0", next);
+                os << "        " << jump(next) << "\n";
+            } break;
+            case Equals:
+            {
+                write_store(os, inst.params[2], inst.param3Mode, "(" + op1 + " == " + op2 + ") ? 1 : 0", next);
+                os << "        " << jump(next) << "\n";
+            } break;
+            case Input:
+            {
+                os << "        int64_t value;\n";
+                os << "        if (!vm.input(&value)) { return vm.suspend(" << pc << ", base, executed, Computer::WaitingForInput); }\n";
+                os << "        ++executed;\n";
+                write_store(os, inst.params[0], inst.param1Mode, "value", next);
+                os << "        " << jump(next) << "\n";
+            } break;
+            case Output:
+            {
+                os << "        if (!vm.output(" << op1 << ")) { return vm.suspend(" << pc << ", base, executed, Computer::WaitingForOutput); }\n";
+                os << "        ++executed;\n";
+                os << "        " << jump(next) << "\n";
+            } break;
+            case JumpIfTrue:
+            case JumpIfFalse:
+            {
+                auto condition = (inst.opcode == JumpIfTrue) ? " != 0" : " == 0";
+                os << "        if (" << op1 << condition << ")\n        {\n";
+                if (inst.param2Mode == ParameterMode::ImmediateMode)
+                {
+                    os << "            " << jump(inst.params[1]) << "\n";
+                }
+                else
+                {
+                    os << "            pc = " << op2 << ";\n";
+                    os << "            goto dispatch;\n";
+                    m_dynamicJumps = true;
+                }
+                os << "        }\n";
+                os << "        " << jump(next) << "\n";
+            } break;
+            case RelativeBaseOffset:
+            {
+                os << "        base = aot_add(base, " << op1 << ");\n";
+                os << "        " << jump(next) << "\n";
+            } break;
+            case Halt:
+            {
+                os << "        return vm.suspend(" << pc << ", base, executed, Computer::Halted);\n";
+            } break;
+            default:
+            {
+                os << "        --executed;\n";
+                os << "        return vm.deoptimize(" << pc << ", base, executed);\n";
+            } break;
+        }
+
+        os << "    }\n\n";
+    }
+
+    const std::vector<int64_t> & m_program;
+    std::vector<bool> m_code;
+    std::set<int64_t> m_starts;
+    bool m_dynamicJumps;
+};
+
+int main(int argc, char * argv[])
+{
+    if (argc < 3)
+    {
+        std::cout << "Usage: intcode2cpp <program> <symbol> [output]" << std::endl;
+
+        return 1;
+    }
+
+    std::vector<int64_t> program;
+    read_program(argv[1], &program);
+
+    if (program.empty())
+    {
+        std::cerr << "Could not read a program from " << argv[1] << std::endl;
+
+        return 1;
+    }
+
+    Translator translator(program);
+
+    if (argc > 3)
+    {
+        std::ofstream fs(argv[3]);
+        translator.write(fs, argv[1], argv[2]);
+    }
+    else
+    {
+        translator.write(std::cout, argv[1], argv[2]);
+    }
+
+    return 0;
+}
@@ -0,0 +1,56 @@
+// Converts an Intcode program from the comma-separated text format into the
+// binary image format in intcode/image.h, or checks an existing image.
+//
+//     intcode2image <program> <image> [--no-decode]
+//     intcode2image --verify <image>
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../intcode/image.h"
+#include "../intcode/program.h"
+
+int main(int argc, char * argv[])
+{
+    if (argc < 3)
+    {
+        std::cout << "Usage: intcode2image <program> <image> [--no-decode]" << std::endl;
+        std::cout << "       intcode2image --verify <image>" << std::endl;
+
+        return 1;
+    }
+
+    if (std::string(argv[1]) == "--verify")
+    {
+        if (!Image::verify(argv[2]))
+        {
+            std::cerr << argv[2] << " is not a valid image" << std::endl;
+
+            return 1;
+        }
+
+        return 0;
+    }
+
+    std::vector<int64_t> program;
+    read_program(argv[1], &program);
+
+    if (program.empty())
+    {
+        std::cerr << "Could not read a program from " << argv[1] << std::endl;
+
+        return 1;
+    }
+
+    auto decoded = !(argc > 3 && std::string(argv[3]) == "--no-decode");
+    if (!Image::save(program, argv[2], decoded))
+    {
+        std::cerr << "Could not write " << argv[2] << std::endl;
+
+        return 1;
+    }
+
+    return 0;
+}